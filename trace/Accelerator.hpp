@@ -0,0 +1,57 @@
+// common interface for acceleration structures over scene objects
+#ifndef ACCELERATOR_HPP
+#define ACCELERATOR_HPP
+
+// other classes we use DIRECTLY in our interface
+#include "Intersection.hpp"
+#include "Ray.hpp"
+#include "RayPacket.hpp"
+
+// classes we only use by pointer or reference
+class Object;
+
+// an acceleration structure answers the same queries as a front-to-back
+// scan of the object list, and must give the same answers
+class Accelerator {
+    friend class LeafBlocks;        // tests the leaves of derived classes
+
+protected: // types and helpers for derived classes
+    // object with its position in the original list, which breaks ties
+    // between equal t exactly the way a front-to-back list scan does
+    struct Prim {
+        const Object *obj;
+        int index;
+    };
+
+    // is hit h from the object at original position i closer than the
+    // closest so far? Ties go to the earlier object, like a list scan
+    static bool closer(const Intersection &h, int i,
+                       const Intersection &closest, int closestIndex)
+    {
+        return h < closest ||
+            (h.t == closest.t && h.t < INFINITY && i < closestIndex);
+    }
+
+public: // destructor
+    virtual ~Accelerator() {}
+
+public: // accessors
+    // short name for reporting
+    virtual const char *name() const = 0;
+
+public: // computational members
+    // closest intersection with ray r
+    virtual const Intersection trace(Ray r) const = 0;
+
+    // any object intersecting r between r.near and r.far, or 0 if none
+    virtual const Object *occluder(Ray r) const = 0;
+
+    // closest intersection for each ray of packet p, the same as tracing
+    // them one by one, which is what structures without packet support do
+    virtual void tracePacket(const RayPacket &p, Intersection hit[]) const {
+        for(int i=0; i != p.size(); ++i)
+            hit[i] = trace(p.ray(i));
+    }
+};
+
+#endif
@@ -5,13 +5,206 @@
 #include "Appearance.hpp"
 
 // other classes used directly in the implementation
+#include "Intersection.hpp"
 #include "World.hpp"
 #include "Ray.hpp"
+#include "ShadowCache.hpp"
+#include "Stats.hpp"
 
-// Color of this object
-const Vec3
-Appearance::eval(const World &world, const Vec3 &p, 
-        const Vec3 &n, const Ray &r) const
+// system includes
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+// scoped globals for light sampling and bounces
+int Appearance::lightSamples = 0;
+int Appearance::depth = 5;
+
+// Shading is written once as templates on the effects bits. Each
+// combination of the bits in SHADING is its own instantiation, with every
+// effects test folded away at compile time, and the DYNAMIC one tests
+// World::effects as it goes
+static const unsigned SHADING = World::DIFFUSE | World::SPECULAR |
+    World::SHADOW | World::REFLECT | World::REFRACT;
+static const unsigned DYNAMIC = ~0u;
+
+// is effect bit on for shading variant E?
+template <unsigned E>
+static inline bool on(unsigned bit)
+{
+    return E == DYNAMIC ? (World::effects & bit) != 0 : (E & bit) != 0;
+}
+
+// reflected or refracted ray waiting to be traced, with the fraction of
+// its color that adds into the color eval is finding
+struct PendingRay {
+    Ray ray;
+    float weight;
+};
+
+// per-thread stack of rays waiting, kept between calls. The newest ray
+// is traced first, so besides its children at most one ray from each
+// bounce before waits: never more than a ray's bounces plus two, which
+// is allocated before any are pushed
+static thread_local std::vector<PendingRay> t_pending;
+
+// diffuse and specular for one light
+template <unsigned E>
+static inline void addLight(const Appearance &a, Vec3 &col, const Light &li,
+                            const Vec3 &p, const Vec3 &n, const Vec3 &V)
+{
+    // normalized L and H
+    Vec3 L = normalize(li.pos - p);
+    Vec3 H = normalize(V+L);
+
+    float diffuse = dot(n,L);
+    if (diffuse > 0) {
+        Vec3 dc = li.col * a.color;
+        if (on<E>(World::DIFFUSE))
+            col = col + a.kd*diffuse*dc;
+
+        if (a.ks > 0 && on<E>(World::SPECULAR)) {
+            float specular = dot(n,H);
+            if (specular > 0)
+                col = col + a.ks*diffuse*pow(specular,a.e)*li.col;
+        }
+    }
+}
+
+// reflected ray
+template <unsigned E>
+static inline bool reflection(const Appearance &a, const Ray &r,
+                              const Vec3 &p, const Vec3 &n, Ray &out)
+{
+    if (! on<E>(World::REFLECT) || r.influence * a.ks <= 1 || r.bounces <= 0)
+        return false;
+
+    // reflect ray off surface
+    Vec3 rv = r.direction - 2*dot(n, r.direction)*n;
+
+    // new ray with one less bounce and influence reduced by kr
+    out = Ray(p, rv, 1e-4f, INFINITY, r.bounces-1, r.influence*a.ks, r.sample);
+    Stats::ray(Stats::REFLECTION, out.bounces);
+    return true;
+}
+
+// refracted ray
+template <unsigned E>
+static inline bool refraction(const Appearance &a, const Ray &r,
+                              const Vec3 &p, const Vec3 &n, const Vec3 &V,
+                              Ray &out)
+{
+    if (! on<E>(World::REFRACT) || r.influence * a.kt <= 1 || r.bounces <= 0)
+        return false;
+
+    // compute refracted ray
+    float ci = dot(n,V);                // cosine of incident ray angle
+    float tir = ci > 0 ? 1/a.ir : a.ir; // ratio of air to object or object to air
+    float ct2 = 1-(1-ci*ci)*tir*tir;    // cosine squared of refracted ray
+    if (ct2 <= 0)                       // total internal reflection
+        return false;
+
+    // ray direction
+    Vec3 td;
+    if (ci>0)                           // into surface
+        td = n*(ci*tir - sqrtf(ct2)) - V*tir;
+    else                                // out of surface
+        td = n*(ci*tir + sqrtf(ct2)) - V*tir;
+
+    // new ray with one fewer bounce and influence reduced by kt
+    out = Ray(p, td, 1e-4f, INFINITY, r.bounces-1, r.influence*a.kt, r.sample);
+    Stats::ray(Stats::REFRACTION, out.bounces);
+    return true;
+}
+
+// scramble the bits of x
+static inline unsigned hash(unsigned x)
+{
+    x ^= x >> 16; x *= 0x7feb352d;
+    x ^= x >> 15; x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+// seed made from a hit point and the ray reaching it, so the same hit
+// always picks the same lights whatever thread or order it is shaded in.
+// The ray's pixel sample is part of it: without antialiasing or depth
+// of field every sample of a pixel hits the same point from the same
+// direction, and they need different lights to converge
+static unsigned seed(const Vec3 &p, const Ray &r)
+{
+    const Vec3 &d = r.direction;
+    unsigned s = hash(r.sample);        // 0 for sample 0
+    for(int i=0; i<3; ++i) {
+        float f[2] = { p[i], d[i] };
+        unsigned bits[2];
+        memcpy(bits, f, sizeof(bits));
+        s = hash(s ^ bits[0]);
+        s = hash(s ^ bits[1]);
+    }
+    return s;
+}
+
+// per-thread space for light weights, kept between hits
+struct LightWeights {
+    std::vector<float> weight;      // estimated contribution of each light
+    std::vector<float> cdf;         // running sum of weight
+};
+static thread_local LightWeights t_weights;
+
+// diffuse and specular from Appearance::lightSamples shadow rays. Each
+// goes to light l with probability w_l/W, where w_l is its brightness
+// times the cosine at p, zero only if the light can't contribute. Dividing
+// each light's color by its probability keeps the estimate unbiased, so
+// more samples per pixel converge to the sum over every light
+template <unsigned E>
+static void sampleLights(const Appearance &a, Vec3 &col, const World &world,
+                         const Vec3 &p, const Vec3 &n, const Vec3 &V,
+                         const Ray &r)
+{
+    const LightList &lights = world.lights;
+    int count = int(lights.size());
+    std::vector<float> &weight = t_weights.weight, &cdf = t_weights.cdf;
+    weight.resize(count);
+    cdf.resize(count);
+
+    float total = 0;
+    for(int l=0; l<count; ++l) {
+        const Vec3 &c = lights[l].col;
+        float cosine = dot(n, normalize(lights[l].pos - p));
+        weight[l] = cosine > 0 ? (fabsf(c[0]) + fabsf(c[1]) + fabsf(c[2])) * cosine : 0;
+        total += weight[l];
+        cdf[l] = total;
+    }
+    if (! (total > 0)) return;          // no light reaches p
+
+    int samples = Appearance::lightSamples;
+    unsigned s = seed(p, r);
+    Vec3 sum;
+    for(int i=0; i<samples; ++i) {
+        // pick a light with a uniform number in [0,total)
+        float u = float(hash(s + i) >> 8) * (1.f/16777216) * total;
+        int l = int(std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+        if (l >= count || weight[l] <= 0) continue;     // rounding at the ends
+
+        if (on<E>(World::SHADOW) &&
+            ShadowCache::blocked(world.objects, l,
+                                 Ray(p,lights[l].pos - p,1e-4f,1.f)))
+            continue;
+
+        Vec3 c;
+        addLight<E>(a, c, lights[l], p, n, V);
+        sum = sum + (total / (weight[l] * samples)) * c;
+    }
+    col = col + sum;
+}
+
+// Color of this object lit directly, queuing reflected and refracted
+// rays with weight times their share
+template <unsigned E>
+static const Vec3 shade(const Appearance &a, const World &world,
+                        const Vec3 &p, const Vec3 &n, const Ray &r,
+                        float weight, std::vector<PendingRay> &pending)
 {
     // base color
     Vec3 col = Vec3(0,0,0);
@@ -20,69 +213,121 @@ Appearance::eval(const World &world, const Vec3 &p,
     Vec3 V = -normalize(r.direction);
 
     // diffuse and specular
-    for (LightList::const_iterator li=world.lights.begin();
-         li != world.lights.end(); ++li) {
-
-        Vec3 L = li->pos - p;   // light vector
-
-        // cast ray to see if it's in shadow
-        if (! (World::effects & World::SHADOW) || 
-            ! world.objects.probe(Ray(p,L,1e-4f,1.f))) {
-
-            // normalized L and H
-            L = normalize(L);
-            Vec3 H = normalize(V+L);
-
-            float diffuse = dot(n,L);
-            if (diffuse > 0) {
-                Vec3 dc = li->col * color;
-                if (World::effects & World::DIFFUSE)
-                    col = col + kd*diffuse*dc;
-
-                if (ks > 0 && (World::effects & World::SPECULAR)) {
-                    float specular = dot(n,H);
-                    if (specular > 0)
-                        col = col + ks*diffuse*pow(specular,e)*li->col;
-                }
-            }
+    if ((on<E>(World::DIFFUSE) || on<E>(World::SPECULAR)) &&
+        Appearance::lightSamples > 0 &&
+        int(world.lights.size()) > Appearance::lightSamples)
+        sampleLights<E>(a, col, world, p, n, V, r);
+    else if (on<E>(World::DIFFUSE) || on<E>(World::SPECULAR)) {
+        int light = 0;
+        for (LightList::const_iterator li=world.lights.begin();
+             li != world.lights.end(); ++li, ++light) {
+
+            // cast ray to see if it's in shadow
+            if (! on<E>(World::SHADOW) ||
+                ! ShadowCache::blocked(world.objects, light,
+                                       Ray(p,li->pos - p,1e-4f,1.f)))
+                addLight<E>(a, col, *li, p, n, V);
         }
     }
 
-    // reflected rays
-    if ((World::effects & World::REFLECT) &&
-         r.influence * ks > 1 && r.bounces > 0) {
+    // refracted and reflected rays, reflection on top to go first
+    PendingRay next = { r, 0 };
+    if (refraction<E>(a, r, p, n, V, next.ray)) {
+        next.weight = weight * a.kt;
+        pending.push_back(next);
+    }
+    if (reflection<E>(a, r, p, n, next.ray)) {
+        next.weight = weight * a.ks;
+        pending.push_back(next);
+    }
+
+    return col;
+}
 
-        // reflect ray off surface
-        Vec3 rv = r.direction - 2*dot(n, r.direction)*n;
+// Color of this object and everything seen in it: the hit's own color,
+// then each waiting ray's color times its weight, until none are left
+template <unsigned E>
+static const Vec3 shadeAll(const Appearance &a, const World &world,
+                           const Vec3 &p, const Vec3 &n, const Ray &r)
+{
+    std::vector<PendingRay> &pending = t_pending;
+    size_t base = pending.size();
+    if (r.bounces > 0 && pending.capacity() < base + r.bounces + 2)
+        pending.reserve(base + r.bounces + 2);
 
-        // new ray with one less bounce and influence reduced by kr
-        Ray rr(p, rv, 1e-4f, INFINITY, r.bounces-1, r.influence*ks);
-        Vec3 rc = world.objects.trace(rr).color(world,rr); // trace ray
-        col = col + ks * rc;
-    }
+    Vec3 col = shade<E>(a, world, p, n, r, 1, pending);
+    while(pending.size() > base) {
+        PendingRay next = pending.back();
+        pending.pop_back();
 
-    // refracted rays
-    if ((World::effects & World::REFRACT) &&
-            r.influence * kt > 1 && r.bounces > 0) {
-
-        // compute refracted ray
-        float ci = dot(n,V);                // cosine of incident ray angle
-        float tir = ci > 0 ? 1/ir : ir;     // ratio of air to object or object to air
-        float ct2 = 1-(1-ci*ci)*tir*tir;    // cosine squared of refracted ray
-        if (ct2 > 0) {                  // <=0 for total internal reflection
-            // ray direction
-            Vec3 td;
-            if (ci>0)                   // into surface
-                td = n*(ci*tir - sqrtf(ct2)) - V*tir;
-            else                        // out of surface
-                td = n*(ci*tir + sqrtf(ct2)) - V*tir;
-
-            // new ray with one fewer bounce and influence reduced by kt
-            Ray tr(p, td, 1e-4f, INFINITY, r.bounces-1, r.influence*kt);
-            Vec3 tc = world.objects.trace(tr).color(world,tr); // trace ray
-            col = col + kt * tc;
+        Intersection hit = world.objects.trace(next.ray);
+        if (! hit.object()) {
+            col = col + next.weight * world.background;
+            continue;
         }
-    }
 
+        Vec3 hp, hn;
+        const Appearance &app = hit.surface(next.ray, hp, hn);
+        col = col + next.weight *
+            shade<E>(app, world, hp, hn, next.ray, next.weight, pending);
+    }
     return col;
 }
+
+// table of every fixed variant, indexed by effects & SHADING
+typedef const Vec3 (*ShadeFunction)(const Appearance &, const World &,
+                                    const Vec3 &, const Vec3 &, const Ray &);
+template <unsigned E>
+struct ShadeTable {
+    static void fill(ShadeFunction table[]) {
+        table[E] = shadeAll<E>;
+        ShadeTable<E-1>::fill(table);
+    }
+};
+template <>
+struct ShadeTable<0> {
+    static void fill(ShadeFunction table[]) { table[0] = shadeAll<0>; }
+};
+
+// variant used by eval
+static ShadeFunction s_shade = shadeAll<DYNAMIC>;
+
+// use the variant for these effects from now on
+void
+Appearance::specialize(unsigned effects)
+{
+    static ShadeFunction table[SHADING+1];
+    if (! table[0])
+        ShadeTable<SHADING>::fill(table);
+    s_shade = table[effects & SHADING];
+}
+
+// Color of this object
+const Vec3
+Appearance::eval(const World &world, const Vec3 &p, 
+        const Vec3 &n, const Ray &r) const
+{
+    return s_shade(*this, world, p, n, r);
+}
+
+// pieces of eval, testing World::effects as they go
+void
+Appearance::addLight(Vec3 &col, const Light &li, const Vec3 &p,
+                     const Vec3 &n, const Vec3 &V) const
+{
+    ::addLight<DYNAMIC>(*this, col, li, p, n, V);
+}
+
+bool
+Appearance::reflection(const Ray &r, const Vec3 &p, const Vec3 &n,
+                       Ray &out) const
+{
+    return ::reflection<DYNAMIC>(*this, r, p, n, out);
+}
+
+bool
+Appearance::refraction(const Ray &r, const Vec3 &p, const Vec3 &n,
+                       const Vec3 &V, Ray &out) const
+{
+    return ::refraction<DYNAMIC>(*this, r, p, n, V, out);
+}
@@ -8,6 +8,7 @@
 // classes we only use by pointer or reference
 class World;
 class Ray;
+struct Light;
 
 class Appearance {
 public: // public data
@@ -20,11 +21,43 @@ public: // constructors
     Appearance() : color(Vec3(1,1,1)), kd(0), ks(0), e(0), kt(0), ir(1) {}
     // also allow default copy constructor and assignment operator
 
+public: // shading variant selection
+    // Shading, including the rays it traces, is compiled once for each
+    // combination of World::effects shading bits. Until this is called
+    // the bits are tested as shading goes; after, eval uses the variant
+    // built for the shading bits in effects, with no tests left in it
+    static void specialize(unsigned effects);
+
+    // if > 0 and there are more lights than this, estimate the light
+    // reaching each hit from this many shadow rays, toward lights picked
+    // in proportion to their likely contribution. 0 to use every light
+    static int lightSamples;
+
+    // reflections and refractions a primary ray may bounce through, which
+    // also bounds the rays eval keeps waiting at once
+    static int depth;
+
 public: // computational members
     // return color for appearance of this surface for point at p, with
-    // normal n and view ray r
+    // normal n and view ray r, including everything seen in it by
+    // reflection and refraction. Those rays are traced one after another
+    // from a stack, each with the fraction of its color that reaches r,
+    // rather than by shading their hits inside this one
     const Vec3 eval(const World &world, const Vec3 &p, 
             const Vec3 &n, const Ray &r) const;
+
+    // pieces of eval, for renderers that trace the rays it needs later:
+    // add unshadowed light li to col for point p with normal n, viewed
+    // from unit direction V
+    void addLight(Vec3 &col, const Light &li, const Vec3 &p,
+                  const Vec3 &n, const Vec3 &V) const;
+
+    // set out to the reflected or refracted ray for view ray r at p with
+    // normal n, returning false if there is none to trace
+    bool reflection(const Ray &r, const Vec3 &p, const Vec3 &n,
+                    Ray &out) const;
+    bool refraction(const Ray &r, const Vec3 &p, const Vec3 &n,
+                    const Vec3 &V, Ray &out) const;
 };
 
 
@@ -0,0 +1,32 @@
+// implementation code for Arena class
+// memory for a scene's objects, allocated in blocks and freed at once
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "Arena.hpp"
+
+// system includes
+#include <stdlib.h>
+
+// blocks are at least this big, so there are few of them
+static const size_t BLOCK = 1 << 20;
+
+// free every block; objects in them are not destroyed
+Arena::~Arena()
+{
+    for(size_t i=0; i != d_blocks.size(); ++i)
+        free(d_blocks[i]);
+}
+
+// start a new block, big enough for an object larger than a block
+char *
+Arena::grow(size_t size, size_t align)
+{
+    size_t bytes = size + align > BLOCK ? size + align : BLOCK;
+    char *block = (char*)malloc(bytes);
+    if (! block) throw std::bad_alloc();
+    d_blocks.push_back(block);
+    d_bytes += bytes;
+    d_end = block + bytes;
+    return (char*)(((size_t)block + align-1) & ~(align-1));
+}
@@ -0,0 +1,52 @@
+// memory for a scene's objects, allocated in blocks and freed at once
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+// system includes necessary for the interface
+#include <new>
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+// Objects are placed one after another in large blocks, so loading a
+// scene takes a handful of allocations rather than one per object, and
+// objects loaded together stay together in memory. Nothing made here is
+// destroyed on its own: the arena frees its blocks without running any
+// destructors, so it only holds objects that own nothing themselves
+class Arena {
+private: // private data
+    std::vector<char*> d_blocks;    // every block, last one in use
+    char *d_next, *d_end;           // free space left in the last block
+    size_t d_bytes;                 // total size of the blocks
+
+public: // constructor and destructor
+    Arena() : d_next(0), d_end(0), d_bytes(0) {}
+    ~Arena();
+
+public: // allocation
+    // size bytes aligned to align, a power of two
+    void *allocate(size_t size, size_t align) {
+        size_t at = ((size_t)d_next + align-1) & ~(align-1);
+        char *p = at + size <= (size_t)d_end ? (char*)at : grow(size, align);
+        d_next = p + size;
+        return p;
+    }
+
+    // new T made from args
+    template <class T, class... Args> T *make(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T)))
+            T(std::forward<Args>(args)...);
+    }
+
+public: // accessors
+    size_t bytes() const { return d_bytes; }
+
+private:
+    // start a new block with room for size bytes aligned to align
+    char *grow(size_t size, size_t align);
+
+    Arena(const Arena &);           // not copyable
+    void operator=(const Arena &);
+};
+
+#endif
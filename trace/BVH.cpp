@@ -0,0 +1,403 @@
+// implementation code for BVH class
+// bounding volume hierarchy over the objects in a scene
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "BVH.hpp"
+
+// other classes used directly in the implementation
+#include "Bits.hpp"
+#include "Object.hpp"
+#include "Sphere.hpp"
+#include "Stats.hpp"
+
+// system includes
+#include <algorithm>
+#include <math.h>
+
+// SAH build parameters
+static const int BINS = 16;             // candidate splits per axis
+static const int MAX_LEAF = 4;          // always split larger leaves
+static const int MAX_DEPTH = 48;        // switch to median splits below this,
+                                        // so depth stays < STACK_SIZE
+static const float TRAVERSAL_COST = 1;  // relative to one intersection test
+
+// object data only needed during the build
+struct BVH::BuildPrim {
+    Box bounds;                 // padded object bounds
+    Vec3 centroid;              // center of bounds
+    Prim prim;                  // object and original index
+};
+
+// which of the BINS this centroid coordinate falls into
+static inline int binOf(float c, float lo, float scale)
+{
+    int b = int((c - lo) * scale);
+    return b < 0 ? 0 : (b >= BINS ? BINS-1 : b);
+}
+
+// build tree over list of objects
+BVH::BVH(const std::vector<const Object*> &objects)
+{
+    std::vector<BuildPrim> prims;
+    prims.reserve(objects.size());
+    for(size_t i=0; i != objects.size(); ++i) {
+        Prim p = { objects[i], int(i) };
+        Box b = objects[i]->bounds();
+        if (! b.finite()) {     // can't place it in the tree, always test it
+            d_unbounded.push_back(p);
+            continue;
+        }
+        b.pad();
+
+        BuildPrim bp;
+        bp.bounds = b;
+        bp.centroid = b.center();
+        bp.prim = p;
+        prims.push_back(bp);
+    }
+
+    if (prims.empty()) return;
+
+    d_node.reserve(2*prims.size());
+    build(prims, 0, int(prims.size()), 0);
+
+    // leaves index into prims, which the build left in leaf order
+    d_prim.reserve(prims.size());
+    for(size_t i=0; i != prims.size(); ++i)
+        d_prim.push_back(prims[i].prim);
+    pack();
+}
+
+// spheres among the leaf objects, for packet tests, and each leaf's
+// objects in blocks, for single rays
+void
+BVH::pack()
+{
+    d_sphere.resize(d_prim.size());
+    for(size_t i=0; i != d_prim.size(); ++i) {
+        const Sphere *s = dynamic_cast<const Sphere*>(d_prim[i].obj);
+        d_sphere[i] = s ? &s->geometry() : 0;
+    }
+
+    d_run.assign(d_node.size(), -1);
+    for(size_t n=0; n != d_node.size(); ++n) {
+        const Node &node = d_node[n];
+        if (! node.count) continue;
+        d_run[n] = d_blocks.begin();
+        for(int i=node.first; i != node.first + node.count; ++i)
+            d_blocks.add(d_prim[i]);
+    }
+}
+
+// build subtree over prims[begin,end) at given depth,
+// returning the index of its root
+int
+BVH::build(std::vector<BuildPrim> &prims, int begin, int end, int depth)
+{
+    int index = int(d_node.size());
+    d_node.push_back(Node());
+
+    Box bounds, cbounds;
+    for(int i=begin; i<end; ++i) {
+        bounds.extend(prims[i].bounds);
+        cbounds.extend(prims[i].centroid);
+    }
+    d_node[index].bounds = bounds;
+    int count = end - begin;
+
+    // cost of each split into centroid bins along each axis:
+    //   left count * left area + right count * right area
+    float bestCost = INFINITY;
+    int bestAxis = -1, bestSplit = 0;
+    for(int axis=0; count > 1 && axis<3; ++axis) {
+        float extent = cbounds.hi[axis] - cbounds.lo[axis];
+        if (! (extent > 0)) continue;
+        float scale = BINS / extent;
+
+        Box binBox[BINS];
+        int binCount[BINS] = {0};
+        for(int i=begin; i<end; ++i) {
+            int b = binOf(prims[i].centroid[axis], cbounds.lo[axis], scale);
+            binBox[b].extend(prims[i].bounds);
+            ++binCount[b];
+        }
+
+        // sweep right to left to get area and count right of each split
+        float rightArea[BINS];
+        int rightCount[BINS];
+        Box acc;
+        int n = 0;
+        for(int b=BINS-1; b>0; --b) {
+            acc.extend(binBox[b]);
+            n += binCount[b];
+            rightArea[b] = acc.area();
+            rightCount[b] = n;
+        }
+
+        // sweep left to right to evaluate each split
+        acc = Box();
+        n = 0;
+        for(int b=0; b<BINS-1; ++b) {
+            acc.extend(binBox[b]);
+            n += binCount[b];
+            if (n == 0 || rightCount[b+1] == 0) continue;
+            float cost = n*acc.area() + rightCount[b+1]*rightArea[b+1];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b+1;
+            }
+        }
+    }
+
+    // make a leaf if no split is possible, or if a small node is
+    // cheaper to intersect directly than to split
+    float area = bounds.area();
+    float splitCost = TRAVERSAL_COST + (area > 0 ? bestCost/area : 0);
+    if (count == 1 || (count <= MAX_LEAF && count <= splitCost) ||
+        (bestAxis < 0 && count <= MAX_LEAF)) {
+        d_node[index].first = begin;
+        d_node[index].count = count;
+        d_node[index].axis = 0;
+        return index;
+    }
+
+    int mid;
+    if (bestAxis >= 0 && depth < MAX_DEPTH) {
+        // partition around best SAH split
+        float lo = cbounds.lo[bestAxis];
+        float scale = BINS / (cbounds.hi[bestAxis] - lo);
+        int i = begin, j = end;
+        while(i < j) {
+            if (binOf(prims[i].centroid[bestAxis], lo, scale) < bestSplit)
+                ++i;
+            else
+                std::swap(prims[i], prims[--j]);
+        }
+        mid = i;
+    }
+    else {
+        // too deep or centroids all equal: split at the median,
+        // which bounds the depth of the tree
+        bestAxis = cbounds.empty() ? 0 : cbounds.longestAxis();
+        mid = (begin + end)/2;
+        std::vector<BuildPrim>::iterator b = prims.begin();
+        struct CentroidLess {
+            int axis;
+            bool operator()(const BuildPrim &p0, const BuildPrim &p1) const {
+                return p0.centroid[axis] < p1.centroid[axis];
+            }
+        } less = { bestAxis };
+        std::nth_element(b+begin, b+mid, b+end, less);
+    }
+
+    build(prims, begin, mid, depth+1);      // first child follows at index+1
+    int second = build(prims, mid, end, depth+1);
+
+    d_node[index].first = second;
+    d_node[index].count = 0;
+    d_node[index].axis = bestAxis;
+    return index;
+}
+
+// box around all bounded objects
+const Box
+BVH::bounds() const
+{
+    if (d_node.empty()) return Box();
+    return d_node[0].bounds;
+}
+
+// closest intersection with ray r
+// r.far shrinks as hits are found, culling boxes beyond the closest hit
+const Intersection
+BVH::trace(Ray r) const
+{
+    Intersection closest;           // no object, t = infinity
+    int closestIndex = 0;
+    LeafBlocks::Lane lane = { -1, 0 }; // block lane closest came from
+
+    // objects outside the tree
+    for(size_t i=0; i != d_unbounded.size(); ++i) {
+        Intersection current = d_unbounded[i].obj->intersect(r);
+        if (closer(current, d_unbounded[i].index, closest, closestIndex)) {
+            closest = current;
+            closestIndex = d_unbounded[i].index;
+            // one step past t so an exact tie can still be found
+            r.far = nextafterf(current.t, INFINITY);
+        }
+    }
+
+    if (d_node.empty()) return closest;
+
+    Vec3 invDir(1/r.direction[0], 1/r.direction[1], 1/r.direction[2]);
+    int stack[STACK_SIZE], top = 0;
+    stack[top++] = 0;
+    while(top) {
+        int n = stack[--top];
+        const Node &node = d_node[n];
+        float tEnter;
+        if (! node.bounds.hit(r.start, invDir, r.near, r.far, tEnter))
+            continue;
+
+        if (node.count)
+            d_blocks.trace(d_run[n], r, closest, closestIndex, lane);
+        else {
+            // push far child first so the near child is visited first
+            if (r.direction[node.axis] < 0) {
+                stack[top++] = n+1;
+                stack[top++] = node.first;
+            }
+            else {
+                stack[top++] = node.first;
+                stack[top++] = n+1;
+            }
+        }
+    }
+
+    // r.far is now just past the hit, which doesn't change what the
+    // object's kernel finds there
+    if (lane.kind >= 0)
+        return d_blocks.intersection(lane, r, closest.t);
+    return closest;
+}
+
+// any object intersecting r between r.near and r.far, or 0 if none
+const Object *
+BVH::occluder(Ray r) const
+{
+    for(size_t i=0; i != d_unbounded.size(); ++i) {
+        if (d_unbounded[i].obj->occludes(r))
+            return d_unbounded[i].obj;
+    }
+
+    if (d_node.empty()) return 0;
+
+    Vec3 invDir(1/r.direction[0], 1/r.direction[1], 1/r.direction[2]);
+    int stack[STACK_SIZE], top = 0;
+    stack[top++] = 0;
+    while(top) {
+        int n = stack[--top];
+        const Node &node = d_node[n];
+        float tEnter;
+        if (! node.bounds.hit(r.start, invDir, r.near, r.far, tEnter))
+            continue;
+
+        if (node.count) {
+            if (const Object *obj = d_blocks.occluder(d_run[n], r))
+                return obj;
+        }
+        else {
+            stack[top++] = node.first;
+            stack[top++] = n+1;
+        }
+    }
+    return 0;
+}
+
+// closest intersection for each ray of packet p
+// the packet goes down the tree together, carrying a mask of the rays
+// that reached each node. A node is skipped if the interval test over the
+// whole packet misses, then each remaining ray is tested on its own
+void
+BVH::tracePacket(const RayPacket &p, Intersection hit[]) const
+{
+    // rays going different ways won't stay together
+    if (! p.coherent()) {
+        Accelerator::tracePacket(p, hit);
+        return;
+    }
+
+    int closestIndex[RayPacket::SIZE];
+    float far[RayPacket::SIZE];
+    for(int i=0; i != p.size(); ++i) {
+        hit[i] = Intersection();
+        closestIndex[i] = 0;
+        far[i] = p.ray(i).far;
+    }
+
+    // objects outside the tree
+    for(size_t i=0; i != d_unbounded.size(); ++i)
+        packetTest(p, p.all(), d_unbounded[i], 0, hit, closestIndex, far);
+
+    if (d_node.empty()) return;
+
+    struct Entry { int node, mask; };
+    Entry stack[STACK_SIZE];
+    int top = 0;
+    Entry root = { 0, p.all() };
+    stack[top++] = root;
+    while(top) {
+        Entry e = stack[--top];
+        const Node &node = d_node[e.node];
+
+        // farthest any ray still looks
+        float maxFar = 0;
+        for(int m = e.mask; m; m &= m-1)
+            maxFar = fmaxf(maxFar, far[lowestBit(m)]);
+        if (! p.mayHit(node.bounds, maxFar))
+            continue;
+        int mask = p.hit(node.bounds, e.mask, far);
+        if (! mask)
+            continue;
+
+        if (node.count) {
+            for(int i=node.first; i != node.first + node.count; ++i)
+                packetTest(p, mask, d_prim[i], d_sphere[i],
+                           hit, closestIndex, far);
+        }
+        else {
+            // all rays step the same way along the axis, so any ray
+            // can pick the near child
+            Entry first = { e.node+1, mask }, second = { node.first, mask };
+            if (p.ray(0).direction[node.axis] < 0) {
+                stack[top++] = first;
+                stack[top++] = second;
+            }
+            else {
+                stack[top++] = second;
+                stack[top++] = first;
+            }
+        }
+    }
+}
+
+// test rays in mask against prim, keeping each ray's closest hit
+void
+BVH::packetTest(const RayPacket &p, int mask, const Prim &prim,
+                const SphereGeometry *sphere, Intersection hit[],
+                int closestIndex[], float far[]) const
+{
+    float t[RayPacket::SIZE];
+    if (sphere) {
+        p.sphere(*sphere, mask, far, t);
+        int tests = 0, hits = 0;
+        for(int m = mask; m; m &= m-1) {
+            ++tests;
+            hits += t[lowestBit(m)] < INFINITY;
+        }
+        Stats::test(Stats::SPHERE, tests, hits);
+    }
+
+    for(int m = mask; m; m &= m-1) {
+        int i = lowestBit(m);
+        Intersection current;
+        if (sphere) {
+            if (t[i] < INFINITY)
+                current = Intersection(prim.obj, t[i]);
+        }
+        else {
+            Ray r = p.ray(i);
+            r.far = far[i];
+            current = prim.obj->intersect(r);
+        }
+
+        if (closer(current, prim.index, hit[i], closestIndex[i])) {
+            hit[i] = current;
+            closestIndex[i] = prim.index;
+            // one step past t so an exact tie can still be found
+            far[i] = nextafterf(current.t, INFINITY);
+        }
+    }
+}
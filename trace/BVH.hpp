@@ -0,0 +1,84 @@
+// bounding volume hierarchy over the objects in a scene
+#ifndef BVH_HPP
+#define BVH_HPP
+
+// other classes we use DIRECTLY in our interface
+#include "Accelerator.hpp"
+#include "Box.hpp"
+#include "Intersection.hpp"
+#include "LeafBlocks.hpp"
+#include "Ray.hpp"
+
+// system includes necessary for the interface
+#include <vector>
+
+// classes we only use by pointer or reference
+class Object;
+struct SphereGeometry;
+
+// binary tree of boxes, built with the surface area heuristic (SAH)
+// nodes are stored depth-first in one array: the first child of an
+// interior node immediately follows it, the second child is at d_node[first]
+class BVH : public Accelerator {
+    friend class SceneFile;         // saves and restores built trees
+
+private: // private types
+    // entries in a traversal stack, which holds one for each level above
+    // a node as well as the node's two children, so no node may be more
+    // than STACK_SIZE-1 levels below the root
+    enum { STACK_SIZE = 128 };
+
+    struct Node {
+        Box bounds;                 // box around everything below this node
+        int first;                  // leaf: first primitive, interior: 2nd child
+        int count;                  // leaf: number of primitives, interior: 0
+        int axis;                   // interior: split axis for ordering
+    };
+
+    std::vector<Node> d_node;       // tree nodes, root first
+    std::vector<Prim> d_prim;       // objects in leaf order
+    std::vector<const SphereGeometry*> d_sphere; // per d_prim, 0 if not a sphere
+    std::vector<Prim> d_unbounded;  // objects without finite bounds
+
+    // leaf objects packed into SIMD blocks, with the run of each leaf
+    // node, for single rays
+    LeafBlocks d_blocks;
+    std::vector<int> d_run;
+
+public: // constructor
+    // build tree over list of objects. Objects are not owned by the BVH
+    BVH(const std::vector<const Object*> &objects);
+
+public: // accessors
+    // box around all bounded objects
+    const Box bounds() const;
+
+    int nodeCount() const { return int(d_node.size()); }
+
+    const char *name() const { return "bvh"; }
+
+public: // computational members
+    // closest intersection with ray r
+    const Intersection trace(Ray r) const;
+
+    // any object intersecting r between r.near and r.far, or 0 if none
+    const Object *occluder(Ray r) const;
+
+    // closest intersection for each ray of packet p
+    void tracePacket(const RayPacket &p, Intersection hit[]) const;
+
+private: // packet helpers
+    // test rays in mask against prim, keeping each ray's closest hit
+    void packetTest(const RayPacket &p, int mask, const Prim &prim,
+                    const SphereGeometry *sphere, Intersection hit[],
+                    int closestIndex[], float far[]) const;
+
+private: // build helpers
+    BVH() {}                        // empty tree, for SceneFile to fill in
+    void pack();                    // set d_sphere and d_blocks from d_prim
+
+    struct BuildPrim;
+    int build(std::vector<BuildPrim> &prims, int begin, int end, int depth);
+};
+
+#endif
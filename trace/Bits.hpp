@@ -0,0 +1,33 @@
+// bit scans on masks, with compiler builtins where there are some
+#ifndef BITS_HPP
+#define BITS_HPP
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// index of the lowest set bit of m, which must not be 0
+inline int lowestBit(unsigned m)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, m);
+    return int(i);
+#else
+    return __builtin_ctz(m);
+#endif
+}
+
+// index of the highest set bit of m, which must not be 0
+inline int highestBit(unsigned m)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanReverse(&i, m);
+    return int(i);
+#else
+    return 31 - __builtin_clz(m);
+#endif
+}
+
+#endif
@@ -0,0 +1,91 @@
+// axis-aligned bounding boxes
+#ifndef BOX_HPP
+#define BOX_HPP
+
+// other classes we use DIRECTLY in our interface
+#include "Vec3.hpp"
+
+// an axis-aligned box from lo to hi
+// a default box is empty (lo > hi) and grows as points are added
+class Box {
+public: // public data
+    Vec3 lo, hi;            // minimum and maximum corners
+
+public: // constructors
+    Box() {
+        lo = Vec3(INFINITY, INFINITY, INFINITY);
+        hi = -lo;
+    }
+    Box(const Vec3 &_lo, const Vec3 &_hi) { lo = _lo; hi = _hi; }
+    // also allow default copy constructor and assignment
+
+public: // manipulators
+    // grow to include point p
+    void extend(const Vec3 &p) {
+        for(int i=0; i<3; ++i) {
+            if (p[i] < lo[i]) lo[i] = p[i];
+            if (p[i] > hi[i]) hi[i] = p[i];
+        }
+    }
+
+    // grow to include box b
+    void extend(const Box &b) { extend(b.lo); extend(b.hi); }
+
+    // grow slightly so rounding in primitive intersection tests can't
+    // put a hit just outside the box
+    void pad() {
+        for(int i=0; i<3; ++i) {
+            float eps = 1e-5f * (fabsf(lo[i]) > fabsf(hi[i]) ?
+                                 fabsf(lo[i]) : fabsf(hi[i])) + 1e-7f;
+            lo[i] -= eps;
+            hi[i] += eps;
+        }
+    }
+
+public: // accessors
+    bool empty() const { return lo[0] > hi[0] || lo[1] > hi[1] || lo[2] > hi[2]; }
+
+    // true if all coordinates are finite numbers
+    bool finite() const {
+        for(int i=0; i<3; ++i)
+            if (!(lo[i] > -INFINITY && hi[i] < INFINITY)) return false;
+        return true;
+    }
+
+    Vec3 center() const { return 0.5f*(lo + hi); }
+
+    // surface area, used by the SAH cost
+    float area() const {
+        if (empty()) return 0;
+        Vec3 d = hi - lo;
+        return 2*(d[0]*d[1] + d[1]*d[2] + d[2]*d[0]);
+    }
+
+    // index of the axis with the largest extent
+    int longestAxis() const {
+        Vec3 d = hi - lo;
+        return d[0] > d[1] ? (d[0] > d[2] ? 0 : 2) : (d[1] > d[2] ? 1 : 2);
+    }
+
+public: // computational members
+    // slab test of the ray segment start + t*dir, near <= t <= far,
+    // given invDir = 1/dir. On a hit, return true and set tEnter
+    // NaNs from 0*infinity fail the comparisons and leave the interval as is
+    bool hit(const Vec3 &start, const Vec3 &invDir,
+             float near, float far, float &tEnter) const
+    {
+        for(int i=0; i<3; ++i) {
+            float t0 = (lo[i] - start[i]) * invDir[i];
+            float t1 = (hi[i] - start[i]) * invDir[i];
+            if (t0 > t1) { float tmp = t0; t0 = t1; t1 = tmp; }
+            t1 *= 1.0000008f;           // conservative against rounding
+            if (t0 > near) near = t0;
+            if (t1 < far) far = t1;
+            if (near > far) return false;
+        }
+        tEnter = near;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,54 @@
+// implementation code for Camera class
+// view and image size for one render
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "Camera.hpp"
+
+// other classes used directly in the implementation
+#include "World.hpp"
+
+// system includes
+#include <math.h>
+
+Camera::Camera(const World &world)
+    : width(world.width), height(world.height), hither(world.hither),
+      eye(world.eye), w(world.w), u(world.u), v(world.v), dist(world.dist),
+      left(world.left), right(world.right),
+      bottom(world.bottom), top(world.top)
+{
+}
+
+float
+Camera::angle() const
+{
+    return float(atan(top / dist) * 360 / M_PI);
+}
+
+// the same view basis World computes from a 'v' record
+void
+Camera::look(const Vec3 &from, const Vec3 &at, const Vec3 &up, float angle)
+{
+    eye = from;
+    w = eye - at;
+    dist = length(w);
+    w = normalize(w);
+    u = normalize(up ^ w);
+    v = w ^ u;
+
+    // solve w/2d = tan(fov/2), where w=2 and fov must be in radians
+    float t = float(tan(angle * M_PI/360));
+    top = dist*t;
+    bottom = -top;
+    right = top * width / height;
+    left = -right;
+}
+
+void
+Camera::resize(int newWidth, int newHeight)
+{
+    width = newWidth;
+    height = newHeight;
+    right = top * width / height;
+    left = -right;
+}
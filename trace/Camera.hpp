@@ -0,0 +1,44 @@
+// view and image size for one render
+#ifndef CAMERA_HPP
+#define CAMERA_HPP
+
+// other classes we use DIRECTLY in our interface
+#include "Vec3.hpp"
+
+// classes we only use by pointer or reference
+class World;
+
+// Starts as the view the scene file gave, which a render can move or
+// resize without changing the scene, so renders that share a scene can
+// each have their own view
+class Camera {
+public: // public data
+    // image size
+    int width, height;
+
+    // near clipping plane distance
+    float hither;
+
+    // view origin and basis parameters
+    Vec3 eye, w, u, v;
+    float dist, left, right, bottom, top;
+
+public: // constructor
+    // the world's view
+    explicit Camera(const World &world);
+
+public: // accessors
+    // view parameters as an NFF file gives them
+    Vec3 at() const { return eye - dist * w; }
+    float angle() const;            // vertical field of view in degrees
+
+public: // manipulators
+    // look from "from" toward "at", with "up" up and a vertical field of
+    // view of angle degrees, as an NFF 'v' record does
+    void look(const Vec3 &from, const Vec3 &at, const Vec3 &up, float angle);
+
+    // new image size, keeping the vertical field of view
+    void resize(int width, int height);
+};
+
+#endif
@@ -0,0 +1,92 @@
+// implementation code for Checkpoint class
+// per-pixel sample sums saved to a file, to resume or extend a render
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "Checkpoint.hpp"
+
+// system includes
+#include <string.h>
+
+// start of file, followed by the pixels
+struct CheckpointHeader {
+    char magic[8];
+    int version;
+    int width, height;
+    int stride;
+    int pixelSize;                  // sizeof(PixelSum) as written
+    Checkpoint::Pattern pattern;
+};
+
+static const char MAGIC[8] = { 'T', 'R', 'A', 'C', 'E', 'C', 'K', 'P' };
+static const int VERSION = 2;
+
+Checkpoint::~Checkpoint()
+{
+    if (d_file) fclose(d_file);
+}
+
+// open existing checkpoint and check it's for this image and samples,
+// or make a new one
+bool
+Checkpoint::open(const char *name, int width, int height, int stride,
+                 const Pattern &pattern)
+{
+    d_width = width;
+    d_height = height;
+
+    CheckpointHeader h;
+    d_file = fopen(name, "r+b");
+    if (d_file) {
+        d_resumed = true;
+        if (fread(&h, sizeof(h), 1, d_file) != 1 ||
+            memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+            h.version != VERSION || h.pixelSize != int(sizeof(PixelSum)) ||
+            h.width != width || h.height != height || h.stride < 1 ||
+            h.pattern.sampling != pattern.sampling ||
+            h.pattern.effects != pattern.effects ||
+            h.pattern.aperture != pattern.aperture)
+            return false;
+        d_stride = h.stride;
+        return true;
+    }
+
+    d_file = fopen(name, "w+b");
+    if (! d_file) return false;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.width = width;
+    h.height = height;
+    h.stride = stride;
+    h.pixelSize = int(sizeof(PixelSum));
+    h.pattern = pattern;
+    d_stride = stride;
+    return fwrite(&h, sizeof(h), 1, d_file) == 1 && fflush(d_file) == 0;
+}
+
+// read lines, leaving any past the end of the file empty
+void
+Checkpoint::load(int top, int bottom, PixelSum sums[])
+{
+    size_t count = size_t(bottom - top) * d_width;
+    size_t got = 0;
+    if (fseek(d_file, long(sizeof(CheckpointHeader) +
+                           sizeof(PixelSum) * size_t(top) * d_width),
+              SEEK_SET) == 0)
+        got = fread(sums, sizeof(PixelSum), count, d_file);
+    for(size_t k=got; k < count; ++k)
+        sums[k] = PixelSum();
+}
+
+// write lines in place, and push them out to the file
+bool
+Checkpoint::save(int top, int bottom, const PixelSum sums[])
+{
+    size_t count = size_t(bottom - top) * d_width;
+    return fseek(d_file, long(sizeof(CheckpointHeader) +
+                              sizeof(PixelSum) * size_t(top) * d_width),
+                 SEEK_SET) == 0 &&
+        fwrite(sums, sizeof(PixelSum), count, d_file) == count &&
+        fflush(d_file) == 0;
+}
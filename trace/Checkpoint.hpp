@@ -0,0 +1,84 @@
+// per-pixel sample sums saved to a file, to resume or extend a render
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+// other classes we use DIRECTLY in our interface
+#include "Vec3.hpp"
+
+// system includes necessary for the interface
+#include <stdio.h>
+
+// running totals for one pixel while it is sampled
+// saved as is in checkpoint files
+struct PixelSum {
+    Vec3 sum;                       // color summed over samples
+    int n;                          // samples so far
+    float mean, m2;                 // Welford mean and squared deviations
+                                    // of brightness
+    PixelSum() : n(0), mean(0), m2(0) {}
+
+    void add(const Vec3 &c) {
+        sum = sum + c;
+        ++n;
+        float y = 0.299f*c[0] + 0.587f*c[1] + 0.114f*c[2];
+        float d = y - mean;
+        mean += d / n;
+        m2 += d * (y - mean);
+    }
+
+    // standard error of the mean brightness
+    float error() const {
+        return n < 2 ? INFINITY : sqrtf(m2 / (n-1) / n);
+    }
+};
+
+// A header, then a PixelSum for every pixel in image order. Lines are
+// loaded before they render and saved once they are done, so only the
+// lines being rendered are in memory, and a run that stops keeps
+// everything saved so far. The file also keeps the number of samples
+// per round of the sample pattern, set by the run that started it, so
+// later runs continue the same sequence of samples, and what the samples
+// vary, which later runs must match for their samples to add up
+class Checkpoint {
+public: // what each sample varies
+    struct Pattern {
+        int sampling;               // Sampler::Type
+        unsigned effects;           // World::effects bits that use samples
+        float aperture;             // for depth of field, else 0
+    };
+
+private: // private data
+    FILE *d_file;                   // open checkpoint, or 0
+    int d_width, d_height;
+    int d_stride;                   // samples per round of the pattern
+    bool d_resumed;                 // file existed before
+
+public: // constructor and destructor
+    Checkpoint() : d_file(0), d_width(0), d_height(0), d_stride(0),
+                   d_resumed(false) {}
+    ~Checkpoint();
+
+public: // accessors
+    int stride() const { return d_stride; }
+    bool resumed() const { return d_resumed; }
+
+public: // manipulators
+    // open checkpoint in name for a width x height image sampled as
+    // pattern says, or start a new one with stride samples per round if
+    // there is none. Returns false if it can't be opened or is for a
+    // different image or pattern
+    bool open(const char *name, int width, int height, int stride,
+              const Pattern &pattern);
+
+    // totals for lines [top,bottom), empty where none were saved
+    void load(int top, int bottom, PixelSum sums[]);
+
+    // save totals for lines [top,bottom), returning false on an error
+    bool save(int top, int bottom, const PixelSum sums[]);
+
+private:
+    Checkpoint(const Checkpoint &);     // not copyable
+    void operator=(const Checkpoint &);
+};
+
+#endif
@@ -0,0 +1,206 @@
+// implementation code for CommandServer class
+// line commands read from stdin or from clients of a UNIX socket
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "CommandServer.hpp"
+
+// other classes used directly in the implementation
+#include "Stats.hpp"
+
+// system includes
+#include <stdarg.h>
+#include <string.h>
+#include <atomic>
+#include <list>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+//////////////////////////////
+// Client
+
+CommandServer::Client::~Client()
+{
+    if (d_close)
+        fclose(d_out);
+    else
+        fflush(d_out);
+}
+
+void
+CommandServer::Client::reply(const char *format, ...)
+{
+    std::lock_guard<std::mutex> hold(d_lock);
+    va_list args;
+    va_start(args, format);
+    vfprintf(d_out, format, args);
+    va_end(args);
+    fputc('\n', d_out);
+    fflush(d_out);
+}
+
+//////////////////////////////
+// CommandServer
+
+// next line of f, however long, without its newline. False at end of file
+static bool readLine(FILE *f, std::string &line)
+{
+    line.clear();
+    char block[1024];
+    while(fgets(block, sizeof(block), f)) {
+        line += block;
+        if (line[line.size()-1] == '\n') {
+            line.resize(line.size()-1);
+            if (! line.empty() && line[line.size()-1] == '\r')
+                line.resize(line.size()-1);
+            return true;
+        }
+    }
+    return ! line.empty();
+}
+
+void
+CommandServer::serveStdin(const Handler &handler)
+{
+    ClientPtr client(new Client(stdout, false));
+    std::string line;
+    while(readLine(stdin, line))
+        if (! handler(client, &line[0]))
+            break;
+}
+
+#ifdef _WIN32
+
+bool
+CommandServer::serveSocket(const char *path, const Handler &)
+{
+    fprintf(stderr, "no UNIX sockets for %s on this system\n", path);
+    return false;
+}
+
+#else
+
+// one connected client and the thread reading its commands
+struct Connection {
+    std::thread thread;
+    int fd;
+    bool done;                      // thread has finished with fd
+};
+
+// a client's commands until it disconnects or one stops the server.
+// Replies go out on a second descriptor, which stays open while the
+// client is still held by work its commands started
+static void serveClient(Connection &conn, std::mutex &lock,
+                        const CommandServer::Handler &handler,
+                        std::atomic<bool> &stopping, int listener)
+{
+    FILE *in = fdopen(conn.fd, "r");
+    FILE *out = fdopen(dup(conn.fd), "w");
+    if (in && out) {
+        CommandServer::ClientPtr client(new CommandServer::Client(out, true));
+        std::string line;
+        while(! stopping && readLine(in, line))
+            if (! handler(client, &line[0])) {
+                stopping = true;
+                shutdown(listener, SHUT_RDWR);  // wakes accept()
+                break;
+            }
+    }
+    else if (out)
+        fclose(out);
+
+    // fd may be reused once closed, so it is forgotten first
+    {
+        std::lock_guard<std::mutex> hold(lock);
+        conn.done = true;
+    }
+    if (in) fclose(in);
+    else close(conn.fd);
+    Stats::flush();
+}
+
+bool
+CommandServer::serveSocket(const char *path, const Handler &handler)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", path);
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+
+    // replace a socket left behind by an earlier server, but nothing else
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(listener, 16) != 0) {
+        fprintf(stderr, "error making socket %s\n", path);
+        if (listener >= 0) close(listener);
+        return false;
+    }
+
+    // a client that leaves before its replies shouldn't end the server
+    signal(SIGPIPE, SIG_IGN);
+
+    std::mutex lock;                // for connections and their done flags
+    std::list<Connection> connections;
+    std::atomic<bool> stopping(false);
+    for(;;) {
+        int fd = accept(listener, 0, 0);
+        if (stopping) {
+            if (fd >= 0) close(fd);
+            break;
+        }
+        if (fd < 0)
+            continue;
+
+        std::lock_guard<std::mutex> hold(lock);
+        for(std::list<Connection>::iterator c = connections.begin();
+            c != connections.end(); )
+            if (c->done) {
+                c->thread.join();
+                c = connections.erase(c);
+            }
+            else
+                ++c;
+
+        connections.push_back(Connection());
+        Connection &conn = connections.back();
+        conn.fd = fd;
+        conn.done = false;
+        conn.thread = std::thread(serveClient, std::ref(conn), std::ref(lock),
+                                  std::cref(handler), std::ref(stopping),
+                                  listener);
+    }
+
+    // end the other clients' reads, then wait for them
+    {
+        std::lock_guard<std::mutex> hold(lock);
+        for(std::list<Connection>::iterator c = connections.begin();
+            c != connections.end(); ++c)
+            if (! c->done)
+                shutdown(c->fd, SHUT_RD);
+    }
+    for(std::list<Connection>::iterator c = connections.begin();
+        c != connections.end(); ++c)
+        c->thread.join();
+
+    close(listener);
+    unlink(path);
+    return true;
+}
+
+#endif
@@ -0,0 +1,49 @@
+// line commands read from stdin or from clients of a UNIX socket
+#ifndef COMMANDSERVER_HPP
+#define COMMANDSERVER_HPP
+
+// system includes necessary for the interface
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+
+// Each line is one command, handed to a handler on the thread that read
+// it. stdin is read on the calling thread, and each socket client on a
+// thread of its own, so commands from different clients are handled at
+// the same time. Replies go back to the client that sent the command, a
+// line at a time, and stay possible for as long as anything holds on to
+// the client, such as work the command started
+class CommandServer {
+public: // public types
+    // where a command came from, and where replies to it go
+    class Client {
+    private:
+        FILE *d_out;
+        bool d_close;               // d_out is ours to close
+        std::mutex d_lock;          // so replies don't interleave
+    public:
+        Client(FILE *out, bool close) : d_out(out), d_close(close) {}
+        ~Client();
+
+        // printf a line, adding the newline
+        void reply(const char *format, ...);
+    };
+    typedef std::shared_ptr<Client> ClientPtr;
+
+    // handle a command, with its newline removed. Returns false to
+    // stop the server
+    typedef std::function<bool(const ClientPtr &client, char *line)> Handler;
+
+public: // computational members
+    // handle commands from stdin, replying on stdout, until end of input
+    // or the handler stops
+    static void serveStdin(const Handler &handler);
+
+    // handle commands from every client connecting to a UNIX socket made
+    // at path, until a handler call stops, then remove it. Returns false
+    // if the socket couldn't be made
+    static bool serveSocket(const char *path, const Handler &handler);
+};
+
+#endif
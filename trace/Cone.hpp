@@ -4,27 +4,133 @@
 
 // other classes we use DIRECTLY in the interface
 #include "Object.hpp"
+#include "Ray.hpp"
 #include "Vec3.hpp"
 
+// system includes necessary for the interface
+#include <math.h>
+
 // classes we only use by pointer or reference
 class Appearance;
 class World;
-class Ray;
+
+// cone geometry and intersection kernel, apart from Cone so
+// cones can also be kept and tested in plain arrays
+struct ConeGeometry {
+    Vec3 base, axis;            // base point and axis vector
+    float rBase, rDiff;         // radius at base and difference to apex
+    Vec3 scaledAxis;            // axis divided by squared length
+
+    // t of first intersection with r beyond r.near, or INFINITY if none
+    // unlike the other kernels, this may return t beyond r.far
+    float hit(const Ray &r) const {
+        float f;
+        return hit(r, f);
+    }
+
+    // the same, also setting f to the fraction of the way from base to
+    // apex of any intersection
+    float hit(const Ray &r, float &f) const {
+        // equation for vector from base to ray: V = E + t D
+        Vec3 E = r.start - base;
+        Vec3 D = r.direction;
+
+        // the cone is defined by
+        //   B = base; b = radius at base
+        //   A = apex; a = radius at apex
+        //   C = center line = A-B; c = difference in radii = a-b
+        //   Cs = scaled C = C/C.C
+        float b = rBase, c = rDiff;
+        Vec3 C = axis, Cs = scaledAxis;
+
+        // for any vector V from B
+        //   f = fraction between B and A = V.C/C.C = V.Cs
+        //     = E.Cs + t D.Cs
+        float E_Cs = dot(E, Cs), D_Cs = dot(D, Cs);
+
+        //   Vp = component of V perpendicular to C = V - f C
+        //     = E + t D - E.Cs C - t D.Cs C
+        //     = (E - E.Cs C) + t (D - D.Cs C)
+        //     = Ep + t Dp
+        Vec3 Ep = E - E_Cs*C, Dp = D - D_Cs*C;
+
+        //   u^2 = squared distance of V from C = Vp.Vp
+        //     = Ep.Ep + 2 t Ep.Dp + t^2 Dp.Dp
+        //
+        //   r = interpolated radius from cone parameters = b + f c
+        //     = b + E.Cs c + t D.Cs c
+        //     = rb + t ra
+        //   r^2 = rb^2 + 2 t rb ra + t^2 ra^2
+        float rb = b + E_Cs*c, ra = D_Cs*c;
+
+        // on cone if u^2 - r^2 == 0
+        //   test = (Ep.Ep-rb^2) + 2 t (Ep.Dp - rb ra) + t^2 (Dp.Dp-ra^2)
+        //     = qc + qb t + qa t^2
+        float qa = dot(Dp, Dp) - ra*ra;
+        float qb = 2*(dot(Ep, Dp) - rb*ra);
+        float qc = dot(Ep, Ep) - rb*rb;
+
+        // quadric term=0 if parallel to one side
+        if (qa == 0) {
+            float t = qc/qb;        // => linear solution for other side
+            if (t < r.near || t > r.far) // outside ray extent
+                return INFINITY;
+            float u = E_Cs + t*D_Cs;
+            if (u<0 || u>=1) return INFINITY; // outside cone limits
+            f = u;
+            return t;
+        }
+
+        // discriminant of quadratic equation
+        float discriminant = qb*qb - 4*qa*qc;
+        if (discriminant < 0)       // no intersection with extended cone
+            return INFINITY;
+
+        float dsq = sqrtf(discriminant);
+
+        // check if intersections are front of ray start
+        // or between base and apex
+        float t1 = (-qb - dsq) / (2*qa);
+        float u1 = E_Cs + t1*D_Cs;
+        if (t1 < r.near) t1 = INFINITY;
+        if (u1<0 || u1 >= 1) t1 = INFINITY;
+
+        float t2 = (-qb + dsq) / (2*qa);
+        float u2 = E_Cs + t2*D_Cs;
+        if (t2 < r.near) t2 = INFINITY;
+        if (u2<0 || u2 >= 1) t2 = INFINITY;
+
+        if (t1<t2) {
+            f = u1;
+            return t1;
+        }
+
+        f = u2;
+        return t2;
+    }
+};
 
 // cone objects
 class Cone : public Object {
-    Vec3 d_base, d_axis;        // base point and axis vector
-    float d_rBase, d_rDiff;     // radius at base and difference to apex
-    Vec3 d_scaledAxis;          // axis divided by squared length
+    ConeGeometry d_geom;
 
 public: // constructors
     Cone(const Appearance &appearance, 
          const Vec3 &base, float base_radius,
          const Vec3 &apex, float apex_radius);
 
+    // cone with derived values already computed, as geometry() gave them
+    Cone(const Appearance &appearance, const ConeGeometry &geom)
+        : Object(appearance), d_geom(geom) {}
+
+public: // accessors
+    const ConeGeometry &geometry() const { return d_geom; }
+
 public: // object functions
     const Intersection intersect(const Ray &ray) const;
-    const Vec3 appearance(const World &w, const Ray &ray, float t) const;
+    const Box bounds() const;
+    const Vec3 normal(const Vec3 &p) const;
+    const Vec3 hitNormal(const HitAttributes &hit) const;
 };
 
 #endif
@@ -0,0 +1,172 @@
+// implementation code for FlatList class
+// scene objects kept by type in contiguous arrays
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "FlatList.hpp"
+
+// other classes used directly in the implementation
+#include "Bits.hpp"
+#include "Object.hpp"
+#include "Polygon.hpp"
+#include "Stats.hpp"
+
+// objects of a type in the first blocks blocks of given size
+static inline int upTo(size_t objects, size_t blocks, int size)
+{
+    return int(blocks*size < objects ? blocks*size : objects);
+}
+
+// sort objects into arrays by type
+FlatList::FlatList(const std::vector<const Object*> &objects)
+{
+    for(size_t i=0; i != objects.size(); ++i) {
+        const Object *obj = objects[i];
+        int kind;
+        if (const Sphere *s = dynamic_cast<const Sphere*>(obj)) {
+            int n = int(d_object[SPHERE].size());
+            if (n % SphereBlock::SIZE == 0) d_sphere.push_back(SphereBlock());
+            d_sphere.back().set(n % SphereBlock::SIZE, s->geometry());
+            kind = SPHERE;
+        }
+        else if (const Cone *c = dynamic_cast<const Cone*>(obj)) {
+            int n = int(d_object[CONE].size());
+            if (n % ConeBlock::SIZE == 0) d_cone.push_back(ConeBlock());
+            d_cone.back().set(n % ConeBlock::SIZE, c->geometry());
+            kind = CONE;
+        }
+        else if (const Triangle *t = dynamic_cast<const Triangle*>(obj)) {
+            int n = int(d_object[TRIANGLE].size());
+            if (n % TriangleBlock::SIZE == 0) d_triangle.push_back(TriangleBlock());
+            d_triangle.back().set(n % TriangleBlock::SIZE, t->geometry());
+            kind = TRIANGLE;
+        }
+        else if (const Polygon *p = dynamic_cast<const Polygon*>(obj)) {
+            d_polygon.push_back(p);
+            kind = POLYGON;
+        }
+        else
+            kind = OTHER;
+
+        d_object[kind].push_back(obj);
+        d_order[kind].push_back(int(i));
+    }
+}
+
+// closest hit over all arrays
+const FlatList::Hit
+FlatList::closest(Ray r) const
+{
+    Hit best = { -1, 0, INFINITY };
+    int bestOrder = 0;
+
+    // lanes are considered in order, so ties resolve as in a scan.
+    // A block is tested against one r.far, but a lane beyond a closer hit
+    // found earlier in the same block is rejected by consider anyway
+    float t[8];
+    int sphereHits = 0, coneHits = 0, triangleHits = 0;
+    for(int b=0; b != int(d_sphere.size()); ++b)
+        for(int m = Simd::spheres(d_sphere[b], r, t); m; m &= m-1) {
+            int lane = lowestBit(m);
+            ++sphereHits;
+            consider(best, bestOrder, r, SPHERE, b*SphereBlock::SIZE + lane, t[lane]);
+        }
+
+    for(int b=0; b != int(d_cone.size()); ++b)
+        for(int m = Simd::cones(d_cone[b], r, t); m; m &= m-1) {
+            int lane = lowestBit(m);
+            ++coneHits;
+            consider(best, bestOrder, r, CONE, b*ConeBlock::SIZE + lane, t[lane]);
+        }
+
+    for(int b=0; b != int(d_triangle.size()); ++b)
+        for(int m = Simd::triangles(d_triangle[b], r, t); m; m &= m-1) {
+            int lane = lowestBit(m);
+            ++triangleHits;
+            consider(best, bestOrder, r, TRIANGLE, b*TriangleBlock::SIZE + lane, t[lane]);
+        }
+
+    // counted once for the whole scan, leaving the loops alone
+    Stats::test(Stats::SPHERE, int(d_object[SPHERE].size()), sphereHits);
+    Stats::test(Stats::CONE, int(d_object[CONE].size()), coneHits);
+    Stats::test(Stats::TRIANGLE, int(d_object[TRIANGLE].size()), triangleHits);
+
+    // qualified call skips the virtual dispatch
+    for(int i=0; i != int(d_polygon.size()); ++i)
+        consider(best, bestOrder, r, POLYGON, i,
+                 d_polygon[i]->Polygon::intersect(r).t);
+
+    const std::vector<const Object*> &other = d_object[OTHER];
+    for(int i=0; i != int(other.size()); ++i)
+        consider(best, bestOrder, r, OTHER, i, other[i]->intersect(r).t);
+
+    return best;
+}
+
+// closest intersection with ray r
+const Intersection
+FlatList::trace(Ray r) const
+{
+    Hit hit = closest(r);
+    if (hit.kind < 0)
+        return Intersection();
+
+    // others may need more than object and t, such as an instance
+    // transform, so ask again for the full intersection. So do polygons,
+    // whose hit attributes save finding their edges again to shade them
+    if (hit.kind == OTHER)
+        return d_object[OTHER][hit.index]->intersect(r);
+    if (hit.kind == POLYGON)
+        return d_polygon[hit.index]->Polygon::intersect(r);
+
+    return Intersection(d_object[hit.kind][hit.index], hit.t);
+}
+
+// any object intersecting r between r.near and r.far
+const Object *
+FlatList::occluder(Ray r) const
+{
+    // the scan stops at the first hit, so every earlier test missed
+    float t[8];
+    size_t spheres = d_object[SPHERE].size(), cones = d_object[CONE].size();
+    size_t triangles = d_object[TRIANGLE].size();
+    for(size_t b=0; b != d_sphere.size(); ++b)
+        for(int m = Simd::spheres(d_sphere[b], r, t); m; m &= m-1) {
+            int lane = lowestBit(m);
+            if (t[lane] < r.far) {
+                Stats::test(Stats::SPHERE, upTo(spheres, b+1, SphereBlock::SIZE), 1);
+                return d_object[SPHERE][b*SphereBlock::SIZE + lane];
+            }
+        }
+    Stats::test(Stats::SPHERE, int(spheres), 0);
+
+    for(size_t b=0; b != d_cone.size(); ++b)
+        for(int m = Simd::cones(d_cone[b], r, t); m; m &= m-1) {
+            int lane = lowestBit(m);
+            if (t[lane] < r.far) {
+                Stats::test(Stats::CONE, upTo(cones, b+1, ConeBlock::SIZE), 1);
+                return d_object[CONE][b*ConeBlock::SIZE + lane];
+            }
+        }
+    Stats::test(Stats::CONE, int(cones), 0);
+
+    for(size_t b=0; b != d_triangle.size(); ++b)
+        for(int m = Simd::triangles(d_triangle[b], r, t); m; m &= m-1) {
+            int lane = lowestBit(m);
+            if (t[lane] < r.far) {
+                Stats::test(Stats::TRIANGLE, upTo(triangles, b+1, TriangleBlock::SIZE), 1);
+                return d_object[TRIANGLE][b*TriangleBlock::SIZE + lane];
+            }
+        }
+    Stats::test(Stats::TRIANGLE, int(triangles), 0);
+
+    for(size_t i=0; i != d_polygon.size(); ++i)
+        if (d_polygon[i]->Polygon::intersect(r).t < r.far)
+            return d_object[POLYGON][i];
+
+    const std::vector<const Object*> &other = d_object[OTHER];
+    for(size_t i=0; i != other.size(); ++i)
+        if (other[i]->occludes(r)) return other[i];
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+// scene objects kept by type in contiguous arrays
+#ifndef FLATLIST_HPP
+#define FLATLIST_HPP
+
+// other classes we use DIRECTLY in our interface
+#include "Accelerator.hpp"
+#include "Cone.hpp"
+#include "Intersection.hpp"
+#include "Ray.hpp"
+#include "Simd.hpp"
+#include "Sphere.hpp"
+#include "Triangle.hpp"
+
+// system includes necessary for the interface
+#include <vector>
+
+// classes we only use by pointer or reference
+class Object;
+class Polygon;
+
+// Every object is still tested, but each type is tested in its own tight
+// loop over a contiguous array of geometry, with the kernel called
+// directly instead of through Object::intersect. Spheres, cones and
+// triangles are packed eight to a block and tested a block at a time by
+// Simd kernels
+class FlatList : public Accelerator {
+public: // public types
+    enum Kind {                     // one array for each
+        SPHERE, CONE, TRIANGLE,     // geometry copied into the array
+        POLYGON,                    // Polygon, called without virtual dispatch
+        OTHER,                      // anything else, through intersect
+        KINDS
+    };
+
+    // closest hit: which array, where in it, and t
+    struct Hit {
+        int kind;                   // -1 if nothing was hit
+        int index;
+        float t;
+    };
+
+private: // private data
+    // entry i is lane i%8 of block i/8
+    std::vector<SphereBlock> d_sphere;
+    std::vector<ConeBlock> d_cone;
+    std::vector<TriangleBlock> d_triangle;
+    std::vector<const Polygon*> d_polygon;
+
+    // for each kind, object and original list position for each entry
+    std::vector<const Object*> d_object[KINDS];
+    std::vector<int> d_order[KINDS];
+
+public: // constructor
+    // sort objects into arrays by type. Objects are not owned by the FlatList
+    FlatList(const std::vector<const Object*> &objects);
+
+public: // accessors
+    const char *name() const { return "flat"; }
+
+public: // computational members
+    // closest hit, found without any virtual calls except for OTHER
+    const Hit closest(Ray r) const;
+
+    // closest intersection with ray r
+    const Intersection trace(Ray r) const;
+
+    // any object intersecting r between r.near and r.far, or 0 if none
+    const Object *occluder(Ray r) const;
+
+private: // helpers
+    // take t from entry i of kind if it is closer than best
+    void consider(Hit &best, int &bestOrder, Ray &r,
+                  int kind, int i, float t) const
+    {
+        int order = d_order[kind][i];
+        if (t < best.t || (t == best.t && t < INFINITY && order < bestOrder)) {
+            best.kind = kind;
+            best.index = i;
+            best.t = t;
+            bestOrder = order;
+            // one step past t so an exact tie can still be found
+            r.far = nextafterf(t, INFINITY);
+        }
+    }
+};
+
+#endif
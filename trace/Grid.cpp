@@ -0,0 +1,299 @@
+// implementation code for Grid class
+// uniform grid over the objects in a scene
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "Grid.hpp"
+
+// other classes used directly in the implementation
+#include "Object.hpp"
+
+// system includes
+#include <math.h>
+
+// grid parameters
+static const float DENSITY = 2;         // target cells per object
+static const int MAX_RES = 512;         // most cells along any axis
+
+// cell containing coordinate x along an axis, clamped to the grid
+static inline int cellOf(float x, float lo, float invSize, int res)
+{
+    int c = int((x - lo) * invSize);
+    return c < 0 ? 0 : (c >= res ? res-1 : c);
+}
+
+// pick cell counts so cells are roughly cubes, with about DENSITY*count
+// cells in total. Flat axes get a single layer of cells
+void
+Grid::resolution(const Box &b, int count, int res[3])
+{
+    Vec3 d = b.hi - b.lo;
+    float maxExtent = d[b.longestAxis()];
+
+    // volume, treating axes much thinner than the largest as flat
+    float volume = 1;
+    int dims = 0;
+    for(int i=0; i<3; ++i) {
+        if (d[i] > 1e-3f * maxExtent) {
+            volume *= d[i];
+            ++dims;
+        }
+    }
+
+    float perUnit = dims ? powf(DENSITY * count / volume, 1.f/dims) : 0;
+    for(int i=0; i<3; ++i) {
+        int r = int(d[i] * perUnit + 0.5f);
+        res[i] = r < 1 ? 1 : (r > MAX_RES ? MAX_RES : r);
+    }
+}
+
+// decide from object layout whether a grid suits this scene:
+// enough cells occupied compared to evenly scattered objects,
+// and objects small enough that they aren't copied into many cells
+bool
+Grid::suits(const std::vector<const Object*> &objects)
+{
+    std::vector<Box> boxes;
+    boxes.reserve(objects.size());
+    Box bounds;
+    for(size_t i=0; i != objects.size(); ++i) {
+        Box b = objects[i]->bounds();
+        if (! b.finite()) continue;
+        boxes.push_back(b);
+        bounds.extend(b);
+    }
+    if (boxes.empty()) return false;
+    bounds.pad();
+
+    int res[3];
+    resolution(bounds, int(boxes.size()), res);
+    Vec3 inv;
+    for(int i=0; i<3; ++i)
+        inv[i] = res[i] / (bounds.hi[i] - bounds.lo[i]);
+
+    std::vector<bool> occupied(size_t(res[0])*res[1]*res[2], false);
+    size_t occupiedCount = 0;
+    double overlap = 0;                 // total cells covered by all objects
+    for(size_t i=0; i != boxes.size(); ++i) {
+        Vec3 c = boxes[i].center();
+        size_t cell = (size_t(cellOf(c[2], bounds.lo[2], inv[2], res[2]))*res[1]
+                       + cellOf(c[1], bounds.lo[1], inv[1], res[1]))*res[0]
+                       + cellOf(c[0], bounds.lo[0], inv[0], res[0]);
+        if (! occupied[cell]) {
+            occupied[cell] = true;
+            ++occupiedCount;
+        }
+
+        double cells = 1;
+        for(int a=0; a<3; ++a)
+            cells *= cellOf(boxes[i].hi[a], bounds.lo[a], inv[a], res[a])
+                - cellOf(boxes[i].lo[a], bounds.lo[a], inv[a], res[a]) + 1;
+        overlap += cells;
+    }
+
+    // expected fraction of occupied cells for n objects scattered
+    // uniformly at random into m cells is 1-exp(-n/m)
+    double n = double(boxes.size()), m = double(occupied.size());
+    double expected = m * (1 - exp(-n/m));
+    return occupiedCount > 0.5 * expected && overlap < 4 * n;
+}
+
+// build grid over list of objects
+Grid::Grid(const std::vector<const Object*> &objects)
+{
+    std::vector<Prim> prims;
+    std::vector<Box> boxes;
+    for(size_t i=0; i != objects.size(); ++i) {
+        Prim p = { objects[i], int(i) };
+        Box b = objects[i]->bounds();
+        if (! b.finite()) {     // can't place it in the grid, always test it
+            d_unbounded.push_back(p);
+            continue;
+        }
+        b.pad();
+        prims.push_back(p);
+        boxes.push_back(b);
+        d_bounds.extend(b);
+    }
+
+    if (prims.empty()) {
+        d_res[0] = d_res[1] = d_res[2] = 0;
+        return;
+    }
+
+    resolution(d_bounds, int(prims.size()), d_res);
+    for(int i=0; i<3; ++i) {
+        d_cellSize[i] = (d_bounds.hi[i] - d_bounds.lo[i]) / d_res[i];
+        d_invCellSize[i] = d_res[i] / (d_bounds.hi[i] - d_bounds.lo[i]);
+    }
+
+    // count objects in each cell, then fill cells in object order
+    // so each cell's list is sorted by original index
+    size_t cells = size_t(d_res[0])*d_res[1]*d_res[2];
+    std::vector<int> cellStart(cells+1, 0);
+    std::vector<Prim> cellPrim;
+    for(int pass=0; pass<2; ++pass) {
+        for(size_t i=0; i != prims.size(); ++i) {
+            int lo[3], hi[3];
+            cellRange(boxes[i], lo, hi);
+            for(int z=lo[2]; z<=hi[2]; ++z)
+                for(int y=lo[1]; y<=hi[1]; ++y)
+                    for(int x=lo[0]; x<=hi[0]; ++x) {
+                        int c = (z*d_res[1] + y)*d_res[0] + x;
+                        if (pass == 0)
+                            ++cellStart[c+1];
+                        else
+                            cellPrim[cellStart[c+1]++] = prims[i];
+                    }
+        }
+
+        if (pass == 0) {
+            // counts to end of each cell's list
+            for(size_t c=0; c != cells; ++c)
+                cellStart[c+1] += cellStart[c];
+            cellPrim.resize(cellStart[cells]);
+            // fill cell c through cellStart[c+1], starting at the
+            // start of cell c and advancing to its end
+            for(size_t c=cells; c != 0; --c)
+                cellStart[c] = cellStart[c-1];
+        }
+    }
+
+    // pack each occupied cell's list into blocks
+    d_cellRun.assign(cells, -1);
+    for(size_t c=0; c != cells; ++c) {
+        if (cellStart[c] == cellStart[c+1]) continue;
+        d_cellRun[c] = d_blocks.begin();
+        for(int i=cellStart[c]; i != cellStart[c+1]; ++i)
+            d_blocks.add(cellPrim[i]);
+    }
+}
+
+// range of cells overlapped by box b
+void
+Grid::cellRange(const Box &b, int lo[3], int hi[3]) const
+{
+    for(int i=0; i<3; ++i) {
+        lo[i] = cellOf(b.lo[i], d_bounds.lo[i], d_invCellSize[i], d_res[i]);
+        hi[i] = cellOf(b.hi[i], d_bounds.lo[i], d_invCellSize[i], d_res[i]);
+    }
+}
+
+// set up 3D-DDA state: starting cell, step direction along each axis,
+// t where the ray leaves the current cell and t to cross one whole cell
+void
+Grid::start(const Ray &r, float tEnter,
+            int cell[3], int step[3], float tMax[3], float tDelta[3]) const
+{
+    for(int i=0; i<3; ++i) {
+        float p = r.start[i] + r.direction[i]*tEnter;
+        cell[i] = cellOf(p, d_bounds.lo[i], d_invCellSize[i], d_res[i]);
+        if (r.direction[i] > 0) {
+            step[i] = 1;
+            tMax[i] = (d_bounds.lo[i] + (cell[i]+1)*d_cellSize[i] - r.start[i])
+                / r.direction[i];
+            tDelta[i] = d_cellSize[i] / r.direction[i];
+        }
+        else if (r.direction[i] < 0) {
+            step[i] = -1;
+            tMax[i] = (d_bounds.lo[i] + cell[i]*d_cellSize[i] - r.start[i])
+                / r.direction[i];
+            tDelta[i] = -d_cellSize[i] / r.direction[i];
+        }
+        else {
+            step[i] = 0;
+            tMax[i] = INFINITY;
+            tDelta[i] = INFINITY;
+        }
+    }
+}
+
+// closest intersection with ray r
+// cells are visited front to back, stopping once the closest hit is
+// before the end of the current cell
+const Intersection
+Grid::trace(Ray r) const
+{
+    Intersection closest;           // no object, t = infinity
+    int closestIndex = 0;
+    LeafBlocks::Lane lane = { -1, 0 }; // block lane closest came from
+
+    // objects outside the grid
+    for(size_t i=0; i != d_unbounded.size(); ++i) {
+        Intersection current = d_unbounded[i].obj->intersect(r);
+        if (closer(current, d_unbounded[i].index, closest, closestIndex)) {
+            closest = current;
+            closestIndex = d_unbounded[i].index;
+            // one step past t so an exact tie can still be found
+            r.far = nextafterf(current.t, INFINITY);
+        }
+    }
+
+    Vec3 invDir(1/r.direction[0], 1/r.direction[1], 1/r.direction[2]);
+    float tEnter;
+    if (d_cellRun.empty() ||
+        ! d_bounds.hit(r.start, invDir, r.near, r.far, tEnter))
+        return closest;
+
+    int cell[3], step[3];
+    float tMax[3], tDelta[3];
+    start(r, tEnter, cell, step, tMax, tDelta);
+
+    for(;;) {
+        // objects in this cell
+        int c = (cell[2]*d_res[1] + cell[1])*d_res[0] + cell[0];
+        if (d_cellRun[c] >= 0)
+            d_blocks.trace(d_cellRun[c], r, closest, closestIndex, lane);
+
+        // step to the neighbor across the nearest cell wall
+        int a = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2)
+                                  : (tMax[1] < tMax[2] ? 1 : 2);
+        if (closest.t < tMax[a] || tMax[a] > r.far) break;
+        cell[a] += step[a];
+        if (cell[a] < 0 || cell[a] >= d_res[a]) break;
+        tMax[a] += tDelta[a];
+    }
+
+    // r.far is now just past the hit, which doesn't change what the
+    // object's kernel finds there
+    if (lane.kind >= 0)
+        return d_blocks.intersection(lane, r, closest.t);
+    return closest;
+}
+
+// any object intersecting r between r.near and r.far, or 0 if none
+const Object *
+Grid::occluder(Ray r) const
+{
+    for(size_t i=0; i != d_unbounded.size(); ++i) {
+        if (d_unbounded[i].obj->occludes(r))
+            return d_unbounded[i].obj;
+    }
+
+    Vec3 invDir(1/r.direction[0], 1/r.direction[1], 1/r.direction[2]);
+    float tEnter;
+    if (d_cellRun.empty() ||
+        ! d_bounds.hit(r.start, invDir, r.near, r.far, tEnter))
+        return 0;
+
+    int cell[3], step[3];
+    float tMax[3], tDelta[3];
+    start(r, tEnter, cell, step, tMax, tDelta);
+
+    for(;;) {
+        int c = (cell[2]*d_res[1] + cell[1])*d_res[0] + cell[0];
+        if (d_cellRun[c] >= 0) {
+            if (const Object *obj = d_blocks.occluder(d_cellRun[c], r))
+                return obj;
+        }
+
+        int a = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2)
+                                  : (tMax[1] < tMax[2] ? 1 : 2);
+        if (tMax[a] > r.far) break;
+        cell[a] += step[a];
+        if (cell[a] < 0 || cell[a] >= d_res[a]) break;
+        tMax[a] += tDelta[a];
+    }
+
+    return 0;
+}
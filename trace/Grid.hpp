@@ -0,0 +1,66 @@
+// uniform grid over the objects in a scene
+#ifndef GRID_HPP
+#define GRID_HPP
+
+// other classes we use DIRECTLY in our interface
+#include "Accelerator.hpp"
+#include "Box.hpp"
+#include "Intersection.hpp"
+#include "LeafBlocks.hpp"
+#include "Ray.hpp"
+
+// system includes necessary for the interface
+#include <vector>
+
+// classes we only use by pointer or reference
+class Object;
+
+// scene box split into equal cells, each listing the objects that overlap
+// it. Rays step from cell to cell in order with a 3D-DDA
+class Grid : public Accelerator {
+private: // private data
+    Box d_bounds;                   // box around all bounded objects
+    int d_res[3];                   // number of cells along each axis
+    Vec3 d_cellSize;                // size of one cell
+    Vec3 d_invCellSize;             // 1/d_cellSize
+
+    // objects of each cell packed into SIMD blocks, with the run of
+    // each cell, -1 if it is empty
+    LeafBlocks d_blocks;
+    std::vector<int> d_cellRun;
+    std::vector<Prim> d_unbounded;  // objects without finite bounds
+
+public: // constructor
+    // build grid over list of objects. Objects are not owned by the Grid
+    Grid(const std::vector<const Object*> &objects);
+
+public: // accessors
+    const char *name() const { return "grid"; }
+
+    // number of cells along axis i
+    int resolution(int i) const { return d_res[i]; }
+
+public: // scene analysis
+    // pick cell counts for count objects in box b
+    static void resolution(const Box &b, int count, int res[3]);
+
+    // are the objects spread evenly enough for a grid to beat a tree?
+    static bool suits(const std::vector<const Object*> &objects);
+
+public: // computational members
+    // closest intersection with ray r
+    const Intersection trace(Ray r) const;
+
+    // any object intersecting r between r.near and r.far, or 0 if none
+    const Object *occluder(Ray r) const;
+
+private: // helpers
+    // range of cells overlapped by box b
+    void cellRange(const Box &b, int lo[3], int hi[3]) const;
+
+    // set up 3D-DDA state for ray r entering the grid at tEnter
+    void start(const Ray &r, float tEnter,
+               int cell[3], int step[3], float tMax[3], float tDelta[3]) const;
+};
+
+#endif
@@ -0,0 +1,144 @@
+// implementation code for HeatMap class
+// per-pixel render cost, written as a false-color image with a legend
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "HeatMap.hpp"
+
+// system includes
+#include <algorithm>
+#include <string.h>
+
+// legend layout, in pixels
+static const int LEGEND_PAD = 4;        // above and below, and at the sides
+static const int BAR = 12;              // height of the color bar
+static const int TICK = 3;              // tick mark below the bar
+static const int SCALE = 2;             // font pixels are SCALE x SCALE
+static const int LEGEND = LEGEND_PAD + BAR + TICK + 2 + 5*SCALE + LEGEND_PAD;
+
+// 3x5 digits and a point, one row per entry, high bit on the left
+static const char FONT_CHARS[] = "0123456789.";
+static const unsigned char FONT[][5] = {
+    {7,5,5,5,7}, {2,6,2,2,7}, {7,1,7,4,7}, {7,1,7,1,7}, {5,5,7,1,1},
+    {7,4,7,1,7}, {7,4,7,5,7}, {7,1,1,1,1}, {7,5,7,5,7}, {7,5,7,1,7},
+    {0,0,0,0,2}
+};
+
+// colors at evenly spaced costs, with straight lines between
+static const float STOPS[][3] = {
+    {0,0,0}, {0.35f,0,0.5f}, {0.85f,0.1f,0.1f}, {1,0.65f,0}, {1,1,1}
+};
+
+float
+HeatMap::maximum() const
+{
+    return d_cost.empty() ? 0 : *std::max_element(d_cost.begin(), d_cost.end());
+}
+
+float
+HeatMap::mean() const
+{
+    double sum = 0;
+    for(size_t i=0; i != d_cost.size(); ++i)
+        sum += d_cost[i];
+    return d_cost.empty() ? 0 : float(sum / d_cost.size());
+}
+
+// color for a cost as a fraction of the largest
+void
+HeatMap::color(float f, unsigned char rgb[3])
+{
+    const int last = int(sizeof(STOPS) / sizeof(STOPS[0])) - 1;
+    f = f > 0 ? (f < 1 ? f : 1) : 0;
+    int s = int(f * last);
+    if (s == last) --s;
+    float w = f * last - s;
+    for(int c=0; c<3; ++c)
+        rgb[c] = (unsigned char)(255.f * ((1-w)*STOPS[s][c] + w*STOPS[s+1][c]) + 0.5f);
+}
+
+// draw text at (x,y) in a width-wide RGB image, where it fits
+static void drawText(std::vector<unsigned char> &image, int width, int height,
+                     int x, int y, const char *text)
+{
+    for(; *text; ++text, x += 4*SCALE) {
+        const char *c = strchr(FONT_CHARS, *text);
+        if (! c) continue;
+        const unsigned char *glyph = FONT[c - FONT_CHARS];
+        for(int row=0; row<5*SCALE; ++row)
+            for(int col=0; col<3*SCALE; ++col) {
+                int px = x + col, py = y + row;
+                if (px < 0 || px >= width || py < 0 || py >= height) continue;
+                if (glyph[row/SCALE] & (4 >> col/SCALE))
+                    memset(&image[3*(size_t(py)*width + px)], 255, 3);
+            }
+    }
+}
+
+// image lines, then a color bar with ticks labeled with their costs
+bool
+HeatMap::writePPM(FILE *f) const
+{
+    float top = maximum();
+    bool ok = fprintf(f, "P6\n%d %d\n255\n", d_width, d_height + LEGEND) > 0;
+
+    std::vector<unsigned char> line(3*d_width);
+    for(int j=0; j<d_height; ++j) {
+        for(int i=0; i<d_width; ++i)
+            color(top > 0 ? d_cost[size_t(j)*d_width + i] / top : 0, &line[3*i]);
+        if (fwrite(&line[0], 1, line.size(), f) != line.size())
+            ok = false;
+    }
+
+    // legend on dark gray
+    std::vector<unsigned char> legend(3*size_t(d_width)*LEGEND, 48);
+    int x0 = LEGEND_PAD, x1 = d_width - LEGEND_PAD;
+    if (x1 - x0 < 2) x0 = 0, x1 = d_width;
+    for(int x=x0; x<x1; ++x) {
+        unsigned char rgb[3];
+        color(float(x - x0) / (x1-1 - x0 > 0 ? x1-1 - x0 : 1), rgb);
+        for(int y=LEGEND_PAD; y<LEGEND_PAD + BAR; ++y)
+            memcpy(&legend[3*(size_t(y)*d_width + x)], rgb, 3);
+    }
+
+    // labels at quarters of the largest cost, skipping any that would
+    // run into the one before
+    int labelY = LEGEND_PAD + BAR + TICK + 2, lastEnd = -1;
+    for(int q=0; q<=4; ++q) {
+        int x = x0 + (x1-1 - x0) * q / 4;
+        for(int y=LEGEND_PAD + BAR; y<LEGEND_PAD + BAR + TICK; ++y)
+            memset(&legend[3*(size_t(y)*d_width + x)], 255, 3);
+
+        char text[32];
+        float value = top * q / 4;
+        snprintf(text, sizeof(text), top >= 100 ? "%.0f" : top >= 10 ? "%.1f" : "%.2f",
+                 value);
+        int w = int(strlen(text)) * 4*SCALE - SCALE;
+        int left = std::max(0, std::min(x - w/2, d_width - w));
+        if (left <= lastEnd) continue;
+        drawText(legend, d_width, LEGEND, left, labelY, text);
+        lastEnd = left + w + SCALE;
+    }
+    if (fwrite(&legend[0], 1, legend.size(), f) != legend.size())
+        ok = false;
+    return ok;
+}
+
+// raw costs as gray, lines bottom to top with little-endian floats
+bool
+HeatMap::writePFM(FILE *f) const
+{
+    int one = 1;
+    bool little = *(char*)&one == 1;
+    bool ok = fprintf(f, "PF\n%d %d\n%s\n", d_width, d_height,
+                      little ? "-1.0" : "1.0") > 0;
+
+    std::vector<float> line(3*d_width);
+    for(int j=d_height-1; j>=0; --j) {
+        for(int i=0; i<d_width; ++i)
+            line[3*i] = line[3*i+1] = line[3*i+2] = d_cost[size_t(j)*d_width + i];
+        if (fwrite(&line[0], sizeof(float), line.size(), f) != line.size())
+            ok = false;
+    }
+    return ok;
+}
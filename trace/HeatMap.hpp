@@ -0,0 +1,39 @@
+// per-pixel render cost, written as a false-color image with a legend
+#ifndef HEATMAP_HPP
+#define HEATMAP_HPP
+
+// system includes necessary for the interface
+#include <stdio.h>
+#include <vector>
+
+// Cost is added to each pixel as it renders, then the whole image is
+// written at the end, once the largest cost is known. PPM files get
+// colors running from black through red and yellow to white, with a
+// bar below the image labeled with the cost for each color. PFM files
+// get the costs themselves as gray, with no legend
+class HeatMap {
+private: // private data
+    int d_width, d_height;
+    std::vector<float> d_cost;      // per pixel, lines top down
+
+public: // constructor
+    HeatMap(int width, int height)
+        : d_width(width), d_height(height), d_cost(size_t(width)*height) {}
+
+public: // accessors
+    // costs for line j, then those for the lines below it
+    float *line(int j) { return &d_cost[size_t(j)*d_width]; }
+
+    float maximum() const;
+    float mean() const;
+
+public: // computational members
+    // write image to f in PPM or PFM format, returning false on an error
+    bool writePPM(FILE *f) const;
+    bool writePFM(FILE *f) const;
+
+    // color for a cost as a fraction of the largest
+    static void color(float f, unsigned char rgb[3]);
+};
+
+#endif
@@ -0,0 +1,122 @@
+// implementation code for ImageWriter class
+// image file written a strip of lines at a time on its own thread
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "ImageWriter.hpp"
+
+// other classes used directly in the implementation
+#include "Stats.hpp"
+
+// system includes
+#include <string.h>
+
+// write header, then start the writer thread
+ImageWriter::ImageWriter(FILE *f, Format format, int width, int height)
+    : d_file(f), d_format(format), d_width(width), d_ok(true),
+      d_full(false), d_done(false)
+{
+    if (format == PFM) {
+        // negative scale for little-endian floats
+        int one = 1;
+        bool little = *(char*)&one == 1;
+        d_ok = fprintf(f, "PF\n%d %d\n%s\n", width, height,
+                       little ? "-1.0" : "1.0") > 0;
+    }
+    else
+        d_ok = fprintf(f, "P6\n%d %d\n255\n", width, height) > 0;
+
+    d_thread = std::thread(&ImageWriter::run, this);
+}
+
+ImageWriter::~ImageWriter()
+{
+    finish();
+}
+
+// PFM for ".pfm", otherwise PPM
+ImageWriter::Format
+ImageWriter::formatOf(const char *name)
+{
+    size_t n = strlen(name);
+    return n >= 4 && strcmp(name + n-4, ".pfm") == 0 ? PFM : PPM;
+}
+
+// hand strip to the writer thread once it has room
+void
+ImageWriter::add(std::vector<Vec3> &strip)
+{
+    std::unique_lock<std::mutex> hold(d_lock);
+    d_changed.wait(hold, [this] { return ! d_full; });
+    d_pending.swap(strip);
+    d_full = true;
+    d_changed.notify_all();
+}
+
+// write what's queued and stop the writer thread
+bool
+ImageWriter::finish()
+{
+    if (d_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> hold(d_lock);
+            d_done = true;
+            d_changed.notify_all();
+        }
+        d_thread.join();
+        if (fflush(d_file) != 0) d_ok = false;
+    }
+    return d_ok;
+}
+
+// write strips as they come, until finish() and nothing is left
+void
+ImageWriter::run()
+{
+    std::vector<Vec3> strip;
+    for(;;) {
+        {
+            std::unique_lock<std::mutex> hold(d_lock);
+            d_changed.wait(hold, [this] { return d_full || d_done; });
+            if (! d_full) {
+                Stats::flush();
+                return;
+            }
+            strip.swap(d_pending);
+            d_full = false;
+            d_changed.notify_all();
+        }
+        put(strip);
+    }
+}
+
+// write one strip's lines in file order
+void
+ImageWriter::put(const std::vector<Vec3> &strip)
+{
+    Stats::Timer write(Stats::WRITE);
+    int lines = int(strip.size()) / d_width;
+    if (d_format == PFM) {
+        std::vector<float> line(3*d_width);
+        for(int j=lines-1; j>=0; --j) {
+            for(int i=0; i<d_width; ++i)
+                for(int c=0; c<3; ++c)
+                    line[3*i + c] = strip[j*d_width + i][c];
+            if (fwrite(&line[0], sizeof(float), line.size(), d_file) != line.size())
+                d_ok = false;
+        }
+    }
+    else {
+        std::vector<unsigned char> line(3*d_width);
+        for(int j=0; j<lines; ++j) {
+            for(int i=0; i<d_width; ++i) {
+                const Vec3 &p = strip[j*d_width + i];
+                line[3*i] = p.r();
+                line[3*i + 1] = p.g();
+                line[3*i + 2] = p.b();
+            }
+            if (fwrite(&line[0], 1, line.size(), d_file) != line.size())
+                d_ok = false;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+// image file written a strip of lines at a time on its own thread
+#ifndef IMAGEWRITER_HPP
+#define IMAGEWRITER_HPP
+
+// other classes we use DIRECTLY in our interface
+#include "Vec3.hpp"
+
+// system includes necessary for the interface
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+// The header goes out when the writer is made, then each strip of lines
+// is appended as it is finished, so the file holds everything rendered
+// so far. PPM is written top to bottom, clamped to bytes. PFM holds the
+// colors as floats, and its lines go bottom to top, so strips for it
+// must be added starting from the bottom of the image.
+// One strip can wait while another is written; adding a third waits
+class ImageWriter {
+public: // public types
+    enum Format { PPM, PFM };
+
+private: // private data
+    FILE *d_file;
+    Format d_format;
+    int d_width;
+    bool d_ok;                      // no write errors so far
+
+    std::mutex d_lock;              // for the rest
+    std::condition_variable d_changed;
+    std::vector<Vec3> d_pending;    // strip waiting to be written
+    bool d_full;                    // d_pending holds a strip
+    bool d_done;                    // no more strips coming
+    std::thread d_thread;
+
+public: // constructor and destructor
+    // write header for width x height image in format to f
+    ImageWriter(FILE *f, Format format, int width, int height);
+
+    // finish writing, but leave f open
+    ~ImageWriter();
+
+public: // accessors
+    // strips go in from the bottom of the image up
+    bool bottomUp() const { return d_format == PFM; }
+
+    // format for file name: PFM for ".pfm", otherwise PPM
+    static Format formatOf(const char *name);
+
+public: // manipulators
+    // queue the strip of whole lines in strip, top line first. strip
+    // comes back holding an old strip to reuse, or empty
+    void add(std::vector<Vec3> &strip);
+
+    // wait for all strips to be written, returning false on an error
+    bool finish();
+
+private: // helpers
+    void run();                     // writer thread
+    void put(const std::vector<Vec3> &strip);
+
+    ImageWriter(const ImageWriter &);   // not copyable
+    void operator=(const ImageWriter &);
+};
+
+#endif
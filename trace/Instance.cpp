@@ -0,0 +1,52 @@
+// implementation code for Instance object class
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "Instance.hpp"
+
+// other classes used directly in the implementation
+#include "ObjectList.hpp"
+#include "Ray.hpp"
+#include "Stats.hpp"
+
+// ray r in the group's object space. The direction is transformed
+// without normalizing, so t is the same along both rays
+static Ray objectRay(const Xform &toObject, const Ray &r)
+{
+    return Ray(toObject.point(r.start), toObject.vector(r.direction),
+               r.near, r.far, r.bounces, r.influence, r.sample);
+}
+
+// trace ray through the group in object space
+const Intersection
+Instance::intersect(const Ray &r) const
+{
+    Intersection hit = d_objects->trace(objectRay(d_toObject, r));
+    Stats::test(Stats::INSTANCE, 1, hit.object() != 0);
+    if (! hit.object()) return Intersection();
+    return hit.instanced(&d_toObject);
+}
+
+// probe the group in object space, stopping at the first object found
+bool
+Instance::occludes(const Ray &r) const
+{
+    bool hit = d_objects->occluder(objectRay(d_toObject, r)) != 0;
+    Stats::test(Stats::INSTANCE, 1, hit);
+    return hit;
+}
+
+// box around the transformed corners of the group's box
+const Box
+Instance::bounds() const
+{
+    Box b = d_objects->bounds(), result;
+    if (! b.finite()) return b;
+    for(int corner=0; corner<8; ++corner) {
+        Vec3 p((corner & 1) ? b.hi[0] : b.lo[0],
+               (corner & 2) ? b.hi[1] : b.lo[1],
+               (corner & 4) ? b.hi[2] : b.lo[2]);
+        result.extend(d_toWorld.point(p));
+    }
+    return result;
+}
@@ -0,0 +1,46 @@
+// instances: transformed references to a shared list of objects
+#ifndef INSTANCE_HPP
+#define INSTANCE_HPP
+
+// other classes we use DIRECTLY in the interface
+#include "Object.hpp"
+#include "Xform.hpp"
+
+// classes we only use by pointer or reference
+class ObjectList;
+class Ray;
+
+// One placement of a shared group of objects. Rays are transformed into
+// the group's object space and traced through the group's own
+// acceleration structure, a second level below the scene's.
+// Groups can't contain instances, so there are only ever two levels
+class Instance : public Object {
+    friend class SceneFile;         // saves group and transforms
+
+private: // private data
+    const ObjectList *d_objects;    // shared group, not owned
+    Xform d_toWorld;                // object to world space
+    Xform d_toObject;               // world to object space
+
+public: // constructors
+    // instance of objects placed by toWorld, which must be invertible
+    Instance(const ObjectList *objects, const Xform &toWorld)
+        : d_objects(objects), d_toWorld(toWorld),
+          d_toObject(toWorld.inverse()) {}
+
+    // instance with the inverse of toWorld already known
+    Instance(const ObjectList *objects, const Xform &toWorld,
+             const Xform &toObject)
+        : d_objects(objects), d_toWorld(toWorld), d_toObject(toObject) {}
+
+public: // object functions
+    // hits report the object hit inside the group, with our transform
+    const Intersection intersect(const Ray &ray) const;
+    bool occludes(const Ray &ray) const;  // any object in the group will do
+    const Box bounds() const;
+
+    // never needed: hits report the object inside, not the instance
+    const Vec3 normal(const Vec3 &) const { return Vec3(0,0,1); }
+};
+
+#endif
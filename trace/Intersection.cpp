@@ -7,19 +7,44 @@
 // other classes used directly in the implementation
 #include "Object.hpp"
 #include "World.hpp"
+#include "Xform.hpp"
 
 
 // new intersection with object and intersection location
-Intersection::Intersection(const Object *_obj, float _t) {
+Intersection::Intersection(const Object *_obj, float _t, const Xform *_toObject) {
     t = _t;
     d_obj = _obj;
+    d_toObject = _toObject;
+    d_hasAttributes = false;
+}
+
+// hit point, normal and appearance for intersection along ray r
+const Appearance &
+Intersection::surface(const Ray &r, Vec3 &p, Vec3 &n) const {
+    p = r.start + r.direction * t;
+    if (d_hasAttributes) {
+        // normal from what intersect found, in object space
+        n = d_obj->hitNormal(d_attributes);
+        if (d_toObject)
+            n = normalize(d_toObject->transposeVector(n));
+    }
+    else if (d_toObject)
+        // instanced object: find normal in object space and bring it back
+        n = normalize(d_toObject->transposeVector(
+                    d_obj->normal(d_toObject->point(p))));
+    else
+        n = d_obj->normal(p);
+    return d_obj->appearance();
 }
 
 // return color for one intersection
 const Vec3 
 Intersection::color(const World &w, const Ray &r) const {
-    if (d_obj)
-        return d_obj->appearance(w, r, t);
+    if (d_obj) {
+        Vec3 p, n;
+        const Appearance &app = surface(r, p, n);
+        return app.eval(w, p, n, r);
+    }
     else
         // background color
         return w.background;
@@ -9,6 +9,19 @@
 class World;
 class Object;
 class Ray;
+class Xform;
+class Appearance;
+
+// what an object's intersect() found out about a hit, so shading it
+// doesn't have to work it out again. Each object type fills in the
+// fields it uses, and finds its normal from them
+struct HitAttributes {
+    Vec3 point;             // hit point in the object's own space
+    float u, v;             // triangle: barycentric coordinates of point
+                            // cone: fraction of the way along the axis, in u
+    int edge[2];            // polygon: first corner of the nearest edges
+                            // crossed behind and ahead of point
+};
 
 // intersection results: contains object hit and t of first intersection point
 class Intersection {
@@ -17,14 +30,44 @@ public: // public data
 
 private: // private data
     const Object *d_obj;    // what did we hit?
+    const Xform *d_toObject; // world to object space if hit through an instance
+    bool d_hasAttributes;   // was d_attributes filled in?
+    HitAttributes d_attributes;
 
 public: // constructors
     // default construct with no object, intersection at infinity
-    Intersection(const Object *_obj=0, float _t=INFINITY);
+    Intersection(const Object *_obj=0, float _t=INFINITY,
+                 const Xform *_toObject=0);
+
+    // hit found by the object's own intersect, with what it learned
+    Intersection(const Object *_obj, float _t, const HitAttributes &_attributes)
+        : t(_t), d_obj(_obj), d_toObject(0), d_hasAttributes(true),
+          d_attributes(_attributes) {}
 
     // we also also allow default copy constructor and assignment
 
+public: // accessors
+    const Object *object() const { return d_obj; }
+
+    // attributes of the hit, or 0 if it was found without them
+    const HitAttributes *attributes() const {
+        return d_hasAttributes ? &d_attributes : 0;
+    }
+
+    // the same hit, on an object placed by an instance with world to
+    // object transform toObject
+    const Intersection instanced(const Xform *toObject) const {
+        Intersection i(*this);
+        i.d_toObject = toObject;
+        return i;
+    }
+
 public: // computational members
+    // world space point p and unit normal n for this intersection with
+    // ray r, returning the appearance to use there. Only valid if an
+    // object was hit
+    const Appearance &surface(const Ray &r, Vec3 &p, Vec3 &n) const;
+
     // get color for this intersection
     const Vec3 color(const World&, const Ray&) const;
 };
@@ -0,0 +1,181 @@
+// implementation code for LeafBlocks class
+// objects of a structure's leaves, packed by type into SIMD blocks
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "LeafBlocks.hpp"
+
+// other classes used directly in the implementation
+#include "Bits.hpp"
+#include "Cone.hpp"
+#include "Object.hpp"
+#include "Sphere.hpp"
+#include "Stats.hpp"
+#include "Triangle.hpp"
+
+// lanes in every kind of block
+static const int LANES = SphereBlock::SIZE;
+
+// test r against the blocks of one kind holding count objects from block
+// first, passing each lane hit to take(slot, t) until it returns true.
+// Returns whether it did
+template <class Block, class Take>
+static inline bool scan(const std::vector<Block> &blocks, int first, int count,
+                        int (*kernel)(const Block &, const Ray &, float *),
+                        Stats::Primitive prim, const Ray &r, Take take)
+{
+    float t[LANES];
+    for(int b=first, left=count; left > 0; ++b, left -= LANES) {
+        int lanes = left < LANES ? left : LANES, hits = 0;
+        for(int m = kernel(blocks[b], r, t); m; m &= m-1) {
+            int lane = lowestBit(m);
+            ++hits;
+            if (take(b*LANES + lane, t[lane])) {
+                Stats::test(prim, lanes, 1);
+                return true;
+            }
+        }
+        Stats::test(prim, lanes, hits);
+    }
+    return false;
+}
+
+// start a new run after the last
+int
+LeafBlocks::begin()
+{
+    Run run;
+    run.block[SPHERE] = int(d_sphere.size());
+    run.block[CONE] = int(d_cone.size());
+    run.block[TRIANGLE] = int(d_triangle.size());
+    for(int k=0; k != KINDS; ++k)
+        run.count[k] = 0;
+    run.other = int(d_other.size());
+    run.others = 0;
+    d_run.push_back(run);
+    return int(d_run.size()) - 1;
+}
+
+// copy geometry g into lane n of the blocks from first, starting a new
+// block when the last is full, and keep prim for that lane
+template <class Block, class Geometry, class Prim>
+static inline void place(std::vector<Block> &blocks, std::vector<Prim> &slots,
+                         int first, int n, const Geometry &g, const Prim &prim)
+{
+    if (n % LANES == 0) {
+        blocks.push_back(Block());
+        slots.resize(blocks.size() * LANES);
+    }
+    blocks.back().set(n % LANES, g);
+    slots[first*LANES + n] = prim;
+}
+
+// add prim to the blocks of its kind, or the others
+void
+LeafBlocks::add(const Accelerator::Prim &prim)
+{
+    Run &run = d_run.back();
+    if (const Sphere *s = dynamic_cast<const Sphere*>(prim.obj))
+        place(d_sphere, d_slot[SPHERE], run.block[SPHERE],
+              run.count[SPHERE]++, s->geometry(), prim);
+    else if (const Cone *c = dynamic_cast<const Cone*>(prim.obj))
+        place(d_cone, d_slot[CONE], run.block[CONE],
+              run.count[CONE]++, c->geometry(), prim);
+    else if (const Triangle *t = dynamic_cast<const Triangle*>(prim.obj))
+        place(d_triangle, d_slot[TRIANGLE], run.block[TRIANGLE],
+              run.count[TRIANGLE]++, t->geometry(), prim);
+    else {
+        d_other.push_back(prim);
+        ++run.others;
+    }
+}
+
+// closer hits in run n
+// lanes come back from one block test against one r.far, so some may be
+// beyond a hit found earlier in the same block. Accelerator::closer
+// rejects those, so the closest hit and tie breaks match a scan
+void
+LeafBlocks::trace(int n, Ray &r, Intersection &closest, int &closestIndex,
+                  Lane &lane) const
+{
+    const Run &run = d_run[n];
+    int kind;
+    auto take = [&](int slot, float t) {
+        const Accelerator::Prim &p = d_slot[kind][slot];
+        Intersection current(p.obj, t);
+        if (Accelerator::closer(current, p.index, closest, closestIndex)) {
+            closest = current;
+            closestIndex = p.index;
+            lane.kind = kind;
+            lane.slot = slot;
+            // one step past t so an exact tie can still be found
+            r.far = nextafterf(t, INFINITY);
+        }
+        return false;
+    };
+    kind = SPHERE;
+    scan(d_sphere, run.block[SPHERE], run.count[SPHERE], &Simd::spheres,
+         Stats::SPHERE, r, take);
+    kind = CONE;
+    scan(d_cone, run.block[CONE], run.count[CONE], &Simd::cones,
+         Stats::CONE, r, take);
+    kind = TRIANGLE;
+    scan(d_triangle, run.block[TRIANGLE], run.count[TRIANGLE],
+         &Simd::triangles, Stats::TRIANGLE, r, take);
+
+    for(int i=run.other; i != run.other + run.others; ++i) {
+        Intersection current = d_other[i].obj->intersect(r);
+        if (Accelerator::closer(current, d_other[i].index,
+                                closest, closestIndex)) {
+            closest = current;
+            closestIndex = d_other[i].index;
+            lane.kind = -1;
+            r.far = nextafterf(current.t, INFINITY);
+        }
+    }
+}
+
+// what the object's own intersect would have returned for the hit at t,
+// worked out with the same arithmetic
+const Intersection
+LeafBlocks::intersection(const Lane &lane, const Ray &r, float t) const
+{
+    const Object *obj = d_slot[lane.kind][lane.slot].obj;
+    HitAttributes hit;
+    if (lane.kind == CONE)
+        static_cast<const Cone*>(obj)->geometry().hit(r, hit.u);
+    else if (lane.kind == TRIANGLE)
+        static_cast<const Triangle*>(obj)->geometry().hit(r, hit.u, hit.v);
+    hit.point = r.start + r.direction * t;
+    return Intersection(obj, t, hit);
+}
+
+// any object in run n intersecting r between r.near and r.far
+const Object *
+LeafBlocks::occluder(int n, const Ray &r) const
+{
+    const Run &run = d_run[n];
+    const Object *found = 0;
+    int kind;
+    auto take = [&](int slot, float t) {
+        if (t < r.far) found = d_slot[kind][slot].obj;
+        return found != 0;
+    };
+    kind = SPHERE;
+    if (scan(d_sphere, run.block[SPHERE], run.count[SPHERE], &Simd::spheres,
+             Stats::SPHERE, r, take))
+        return found;
+    kind = CONE;
+    if (scan(d_cone, run.block[CONE], run.count[CONE], &Simd::cones,
+             Stats::CONE, r, take))
+        return found;
+    kind = TRIANGLE;
+    if (scan(d_triangle, run.block[TRIANGLE], run.count[TRIANGLE],
+             &Simd::triangles, Stats::TRIANGLE, r, take))
+        return found;
+
+    for(int i=run.other; i != run.other + run.others; ++i)
+        if (d_other[i].obj->occludes(r))
+            return d_other[i].obj;
+    return 0;
+}
@@ -0,0 +1,73 @@
+// objects of a structure's leaves, packed by type into SIMD blocks
+#ifndef LEAFBLOCKS_HPP
+#define LEAFBLOCKS_HPP
+
+// other classes we use DIRECTLY in our interface
+#include "Accelerator.hpp"
+#include "Intersection.hpp"
+#include "Ray.hpp"
+#include "Simd.hpp"
+
+// system includes necessary for the interface
+#include <vector>
+
+// classes we only use by pointer or reference
+class Object;
+
+// The objects of each leaf of a tree, or cell of a grid, make a run.
+// A run's spheres, cones and triangles are copied into blocks of their
+// own, so one Simd kernel call tests up to eight of them, and anything
+// else is called through Object::intersect. Hits are taken in the same
+// order as a scan of the run, so answers match one
+class LeafBlocks {
+public: // public types
+    enum Kind { SPHERE, CONE, TRIANGLE, KINDS };
+
+    // which block lane the closest hit so far came from, if any. Its
+    // intersection is made without attributes, which are only worked
+    // out once it is known to be the closest
+    struct Lane {
+        int kind;                   // -1 if found by Object::intersect
+        int slot;                   // block*8 + lane
+    };
+
+private: // private data
+    // first block of each kind, the number of objects of each kind,
+    // and the first other object, for each run
+    struct Run {
+        int block[KINDS], count[KINDS];
+        int other, others;
+    };
+    std::vector<Run> d_run;
+
+    std::vector<SphereBlock> d_sphere;
+    std::vector<ConeBlock> d_cone;
+    std::vector<TriangleBlock> d_triangle;
+
+    // object in each lane of each kind's blocks, or of the others
+    std::vector<Accelerator::Prim> d_slot[KINDS];
+    std::vector<Accelerator::Prim> d_other;
+
+public: // building
+    // start a new run, returning its number
+    int begin();
+
+    // add prim to the newest run
+    void add(const Accelerator::Prim &prim);
+
+public: // computational members
+    // look for hits in run n closer than closest, from the object at
+    // original position closestIndex, shrinking r.far past each one
+    void trace(int n, Ray &r, Intersection &closest, int &closestIndex,
+               Lane &lane) const;
+
+    // the full intersection for a hit from lane, found on ray r
+    const Intersection intersection(const Lane &lane, const Ray &r,
+                                    float t) const;
+
+    // any object in run n intersecting r between r.near and r.far,
+    // or 0 if none
+    const Object *occluder(int n, const Ray &r) const;
+};
+
+#endif
@@ -0,0 +1,49 @@
+// implementation code for MappedFile class
+// whole input file in memory, mapped when possible
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "MappedFile.hpp"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// map or read f from its current position
+MappedFile::MappedFile(FILE *f)
+    : d_data(0), d_size(0), d_mapped(false), d_map(0), d_mapSize(0)
+{
+#ifndef _WIN32
+    struct stat st;
+    long pos = ftell(f);
+    if (pos >= 0 && fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode) &&
+        st.st_size > pos) {
+        void *map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+        if (map != MAP_FAILED) {
+            d_map = map;
+            d_mapSize = st.st_size;
+            d_data = (const char*)map + pos;
+            d_size = st.st_size - pos;
+            d_mapped = true;
+        }
+    }
+#endif
+    if (! d_mapped) {
+        char block[1 << 16];
+        size_t n;
+        while((n = fread(block, 1, sizeof(block), f)) > 0)
+            d_buffer.insert(d_buffer.end(), block, block + n);
+        d_data = d_buffer.empty() ? 0 : &d_buffer[0];
+        d_size = d_buffer.size();
+    }
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+    if (d_mapped)
+        munmap(d_map, d_mapSize);
+#endif
+}
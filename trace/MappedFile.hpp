@@ -0,0 +1,33 @@
+// whole input file in memory, mapped when possible
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+// system includes necessary for the interface
+#include <stdio.h>
+#include <vector>
+
+// A plain file is mapped read-only from its current position to the end.
+// Anything else, like a pipe, is read into a buffer instead
+class MappedFile {
+private: // private data
+    const char *d_data;             // file contents
+    size_t d_size;
+    bool d_mapped;                  // d_data is mapped, not read
+    void *d_map;                    // the mapping, from the start of the file
+    size_t d_mapSize;
+    std::vector<char> d_buffer;     // file contents if not mapped
+
+public: // constructor and destructor
+    MappedFile(FILE *f);
+    ~MappedFile();
+
+public: // accessors
+    const char *data() const { return d_data; }
+    size_t size() const { return d_size; }
+
+private:
+    MappedFile(const MappedFile &); // not copyable
+    void operator=(const MappedFile &);
+};
+
+#endif
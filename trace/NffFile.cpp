@@ -0,0 +1,294 @@
+// implementation code for NffFile class
+// NFF scene file read into memory and parsed in parallel
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "NffFile.hpp"
+
+// other classes used directly in the implementation
+#include "WorkPool.hpp"
+
+// system includes
+#include <charconv>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+// target size of one chunk of text
+static const size_t CHUNK_SIZE = 1 << 20;
+
+// longest group name, as read by "%255s"
+static const int NAME_MAX_LENGTH = 255;
+
+//////////////////////////////
+// pieces of a line, matching what sscanf would accept
+
+// next line of [p,end) as [s,e), advancing p and the line count
+static bool nextLine(const char *&p, const char *end,
+                     const char *&s, const char *&e, int &line)
+{
+    if (p >= end) return false;
+    s = p;
+    const char *nl = (const char*)memchr(p, '\n', end - p);
+    e = nl ? nl : end;
+    p = nl ? nl+1 : end;
+    ++line;
+    return true;
+}
+
+static inline void skipSpace(const char *&s, const char *e)
+{
+    while(s < e && isspace((unsigned char)*s)) ++s;
+}
+
+// literal word at s, like the text of a scanf format
+static bool word(const char *&s, const char *e, const char *w)
+{
+    size_t n = strlen(w);
+    if (size_t(e - s) < n || strncmp(s, w, n) != 0) return false;
+    s += n;
+    return true;
+}
+
+// float like %f: leading space and a '+' are allowed
+static bool number(const char *&s, const char *e, float &x)
+{
+    skipSpace(s, e);
+    const char *p = s;
+    if (p < e && *p == '+') {
+        ++p;
+        if (p < e && *p == '-') return false;
+    }
+    std::from_chars_result r = std::from_chars(p, e, x);
+    if (r.ec == std::errc::result_out_of_range) {
+        // strtof gives the same infinity or zero that %f would
+        std::string copy(p, r.ptr);
+        x = strtof(copy.c_str(), 0);
+    }
+    else if (r.ec != std::errc())
+        return false;
+    s = r.ptr;
+    return true;
+}
+
+// int like %d
+static bool integer(const char *&s, const char *e, int &x)
+{
+    skipSpace(s, e);
+    const char *p = s;
+    if (p < e && *p == '+') {
+        ++p;
+        if (p < e && *p == '-') return false;
+    }
+    std::from_chars_result r = std::from_chars(p, e, x);
+    if (r.ec != std::errc()) return false;
+    s = r.ptr;
+    return true;
+}
+
+// up to max floats into out, returning how many were read
+static int numbers(const char *s, const char *e, float *out, int max)
+{
+    int n = 0;
+    while(n < max && number(s, e, out[n])) ++n;
+    return n;
+}
+
+// word like %255s
+static bool token(const char *&s, const char *e, const char *&name, int &length)
+{
+    skipSpace(s, e);
+    const char *t = s;
+    while(s < e && ! isspace((unsigned char)*s)) ++s;
+    length = int(s - t);
+    if (length > NAME_MAX_LENGTH) length = NAME_MAX_LENGTH;
+    name = t;
+    return length > 0;
+}
+
+//////////////////////////////
+// NffFile
+
+// map or read the file, then split and parse
+NffFile::NffFile(FILE *f, int threads)
+    : d_file(f), d_lines(0)
+{
+    split(CHUNK_SIZE);
+
+    // parse every chunk, then number their lines from the start of the file
+    WorkPool pool(threads);
+    pool.run(chunks(), [&](int i) { parse(d_chunk[i]); });
+
+    int line = 0;
+    for(size_t i=0; i != d_chunk.size(); ++i) {
+        d_chunk[i].firstLine = line + 1;
+        std::vector<Record> &records = d_chunk[i].records;
+        for(size_t r=0; r != records.size(); ++r)
+            records[r].line += line;
+        line += d_chunk[i].lines;
+    }
+    d_lines = line;
+}
+
+// Records of several lines ("v", "p", "pp") continue with lines starting
+// with from, at, up, angle, hither, resolution, or a number. A line
+// starting with b, c, l, p or s is always the start of a record, so it is
+// safe to cut there
+void
+NffFile::split(size_t chunkSize)
+{
+    const char *p = d_file.data(), *end = p + d_file.size();
+    while(p < end) {
+        Chunk c;
+        c.begin = p;
+        c.end = end;
+        c.firstLine = 0;            // known once every chunk is parsed
+        c.lines = 0;
+
+        // first record line at least chunkSize along
+        if (size_t(end - p) > chunkSize) {
+            const char *q = (const char*)memchr(p + chunkSize, '\n',
+                                                end - (p + chunkSize));
+            while(q && q+1 < end) {
+                char first = q[1];
+                if (strchr("bclps", first) && first) {
+                    c.end = q+1;
+                    break;
+                }
+                q = (const char*)memchr(q+1, '\n', end - (q+1));
+            }
+        }
+
+        d_chunk.push_back(c);
+        p = c.end;
+    }
+}
+
+// records and numbers for chunk c, with line numbers counted from the
+// start of the chunk. Stops at the first syntax error, adding a record
+// for it. Counts the lines in c.lines
+void
+NffFile::parse(Chunk &c)
+{
+    const char *p = c.begin, *s, *e;
+    int line = 0;
+    float v[12];
+
+    while(nextLine(p, c.end, s, e, line)) {
+        if (s == e) continue;           // empty line
+
+        Record r = { s[0], false, line, int(c.numbers.size()), 0, 0, 0 };
+        bool ok = true;
+
+        switch(s[0]) {
+            case ' ': case '\t':        // blank lines and comments
+            case '\f': case '\r': case '#':
+                continue;
+
+            case 'v':                   // view: six more lines
+                {
+                    static const char *const key[6] = {
+                        "from", "at", "up", "angle", "hither", "resolution" };
+                    static const int count[6] = { 3, 3, 3, 1, 1, 2 };
+                    for(int k=0; k<6 && ok; ++k) {
+                        if (! nextLine(p, c.end, s, e, line)) {
+                            ++line;     // missing line
+                            ok = false;
+                            break;
+                        }
+                        ok = word(s, e, key[k]);
+                        if (k < 5)
+                            ok = ok && numbers(s, e, v, count[k]) == count[k];
+                        else {
+                            int w, h;
+                            ok = ok && integer(s, e, w) && integer(s, e, h);
+                            v[0] = float(w); v[1] = float(h);
+                        }
+                        c.numbers.insert(c.numbers.end(), v, v + count[k]);
+                    }
+                    break;
+                }
+
+            case 'b':                   // background
+                ok = numbers(s+1, e, v, 3) == 3;
+                c.numbers.insert(c.numbers.end(), v, v+3);
+                break;
+
+            case 'l':                   // light, color optional
+                {
+                    int n = numbers(s+1, e, v, 6);
+                    ok = n >= 3;
+                    c.numbers.insert(c.numbers.end(), v, v+n);
+                    break;
+                }
+
+            case 'f':                   // fill/material properties
+            case 'c':                   // cone or cylinder
+                ok = numbers(s+1, e, v, 8) == 8;
+                c.numbers.insert(c.numbers.end(), v, v+8);
+                break;
+
+            case 's':                   // sphere
+                ok = numbers(s+1, e, v, 4) == 4;
+                c.numbers.insert(c.numbers.end(), v, v+4);
+                break;
+
+            case 'p':                   // polygon: count, then vertex lines
+                {
+                    r.pp = e - s > 1 && s[1] == 'p';
+                    const char *q = s + (e - s < 2 ? e - s : 2);
+                    int nv;
+                    ok = integer(q, e, nv) && nv >= 3;
+                    for(int i=0; i<nv && ok; ++i) {
+                        if (! nextLine(p, c.end, s, e, line)) {
+                            ++line;
+                            ok = false;
+                            break;
+                        }
+                        for(int k=0; k<6; ++k) v[k] = 0;
+                        ok = numbers(s, e, v, 6) >= 3;
+                        c.numbers.insert(c.numbers.end(), v, v+6);
+                    }
+                    break;
+                }
+
+            case 'g':                   // start of named object group
+                ok = word(s, e, "group") && token(s, e, r.name, r.nameLength);
+                break;
+
+            case 'e':                   // end of object group
+                {
+                    const char *name;
+                    int length;
+                    ok = word(s, e, "end") && ! token(s, e, name, length);
+                    break;
+                }
+
+            case 'i':                   // instance: name, then 3 or 12 numbers
+                {
+                    ok = token(++s, e, r.name, r.nameLength);
+                    s = r.name + r.nameLength;
+                    int n = numbers(s, e, v, 12);
+                    c.numbers.insert(c.numbers.end(), v, v+n);
+                    break;
+                }
+
+            default:
+                ok = false;
+        }
+
+        r.count = int(c.numbers.size()) - r.first;
+        if (! ok) {
+            r.type = 0;
+            r.line = line;
+            c.records.push_back(r);
+            break;
+        }
+        c.records.push_back(r);
+    }
+
+    // count the rest of the lines
+    while(nextLine(p, c.end, s, e, line)) {}
+    c.lines = line;
+}
@@ -0,0 +1,61 @@
+// NFF scene file read into memory and parsed in parallel
+#ifndef NFFFILE_HPP
+#define NFFFILE_HPP
+
+// other classes we use DIRECTLY in our interface
+#include "MappedFile.hpp"
+
+// system includes necessary for the interface
+#include <stdio.h>
+#include <vector>
+
+// The whole file is mapped (or read, if it isn't a plain file), cut into
+// chunks at lines that can only start a record, and each chunk's numbers
+// are parsed on its own thread. What's left for the caller is to walk the
+// records in file order, which keeps state like the current material and
+// error reporting exactly as a line-by-line reader would have them
+class NffFile {
+public: // public types
+    // one record: a line and any lines that belong to it
+    struct Record {
+        char type;                  // first letter, or 0 for a syntax error
+        bool pp;                    // 'p': "pp", vertices have normals
+        int line;                   // line number, of the error if type is 0
+        int first, count;           // its numbers in the chunk's numbers
+        const char *name;           // 'g', 'i': group name, not terminated
+        int nameLength;
+    };
+
+    // records for one piece of the file
+    struct Chunk {
+        const char *begin, *end;    // text
+        int firstLine;              // line number of begin
+        int lines;                  // lines in the text
+        std::vector<Record> records;
+        std::vector<float> numbers;
+    };
+
+private: // private data
+    MappedFile d_file;              // whole file
+    std::vector<Chunk> d_chunk;
+    int d_lines;                    // lines in the file
+
+public: // constructor
+    // read f from its current position and parse it using threads
+    // threads (0 for one per core)
+    NffFile(FILE *f, int threads);
+
+public: // accessors
+    int chunks() const { return int(d_chunk.size()); }
+    const Chunk &chunk(int i) const { return d_chunk[i]; }
+    int lines() const { return d_lines; }
+
+private: // helpers
+    void split(size_t chunkSize);   // cut into chunks at record lines
+    static void parse(Chunk &c);    // records and numbers for one chunk
+
+    NffFile(const NffFile &);       // not copyable
+    void operator=(const NffFile &);
+};
+
+#endif
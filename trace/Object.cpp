@@ -4,6 +4,9 @@
 // everything it needs for internal self-consistency
 #include "Object.hpp"
 
+// other classes used directly in the implementation
+#include "Ray.hpp"
+
 // default constructor just uses default color
 Object::Object() {}
 
@@ -14,3 +17,10 @@ Object::Object(const Appearance &_appearance) {
 
 // virtual destructor since this class has virtual members and derived children
 Object::~Object() {}
+
+// closest intersection, for objects with no quicker test
+bool
+Object::occludes(const Ray &ray) const
+{
+    return intersect(ray).t < ray.far;
+}
@@ -4,6 +4,7 @@
 
 // other classes we use DIRECTLY in our interface
 #include "Appearance.hpp"
+#include "Box.hpp"
 #include "Intersection.hpp"
 #include "Vec3.hpp"
 
@@ -25,9 +26,25 @@ public: // computational members
     // return t for closest intersection with ray
     virtual const Intersection intersect(const Ray &ray) const = 0;
 
-    // return color for intersection at t along ray r
-    virtual const Vec3 appearance(const World &w, 
-            const Ray &r, float t) const = 0;
+    // does any intersection lie before ray.far? By default, whether the
+    // closest one does; objects that can stop at the first hit they find
+    // override this
+    virtual bool occludes(const Ray &ray) const;
+
+    // return box enclosing the object
+    virtual const Box bounds() const = 0;
+
+    // return unit shading normal at surface point p
+    virtual const Vec3 normal(const Vec3 &p) const = 0;
+
+    // return unit shading normal at a hit this object's intersect found,
+    // from the attributes it filled in. By default, from the hit point
+    virtual const Vec3 hitNormal(const HitAttributes &hit) const {
+        return normal(hit.point);
+    }
+
+public: // accessors
+    const Appearance &appearance() const { return d_appearance; }
 };
 
 #endif
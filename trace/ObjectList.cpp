@@ -5,18 +5,87 @@
 // everything it needs for internal self-consistency
 #include "ObjectList.hpp"
 #include "Object.hpp"
+#include "BVH.hpp"
+#include "FlatList.hpp"
+#include "Grid.hpp"
+#include "Stats.hpp"
 
-// delete list and objects it contains
+// system includes
+#include <chrono>
+#include <vector>
+
+// scoped global for structure choice
+ObjectList::Accel ObjectList::accel = ObjectList::ACCEL_AUTO;
+
+// lists this short are faster to scan than to traverse
+static const int LIST_MAX = 8;
+
+// delete list and objects it contains, unless its arena holds them
 ObjectList::~ObjectList() {
+    delete d_accel;
+    if (d_arena) return;
     for(t_List::iterator i=d_list.begin(); i != d_list.end(); ++i) {
         delete *i;
     }
 }
 
+// build acceleration structure over objects in list order
+void
+ObjectList::build(Accelerator *prebuilt)
+{
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+    delete d_accel;
+    d_accel = 0;
+    std::vector<const Object*> objects(d_list.begin(), d_list.end());
+
+    d_bounds = Box();
+    for(size_t i=0; i != objects.size(); ++i)
+        d_bounds.extend(objects[i]->bounds());
+
+    if (prebuilt) {
+        d_accel = prebuilt;
+        d_buildTime = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - t0).count();
+        Stats::time(Stats::BUILD, d_buildTime);
+        return;
+    }
+
+    Accel choice = accel;
+    if (choice == ACCEL_AUTO) {
+        if (size() <= LIST_MAX)
+            choice = ACCEL_FLAT;
+        else if (Grid::suits(objects))
+            choice = ACCEL_GRID;
+        else
+            choice = ACCEL_BVH;
+    }
+
+    switch(choice) {
+        case ACCEL_FLAT: d_accel = new FlatList(objects); break;
+        case ACCEL_BVH:  d_accel = new BVH(objects);  break;
+        case ACCEL_GRID: d_accel = new Grid(objects); break;
+        default: break;
+    }
+
+    d_buildTime = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - t0).count();
+    Stats::time(Stats::BUILD, d_buildTime);
+}
+
+// name of structure in use
+const char *
+ObjectList::accelName() const
+{
+    return d_accel ? d_accel->name() : "list";
+}
+
 // trace ray r through all objects, returning first intersection
 const Intersection
 ObjectList::trace(Ray r) const
 {
+    if (d_accel) return d_accel->trace(r);
+
     Intersection closest;       // no object, t = infinity
     for(t_List::const_iterator i=d_list.begin(); i != d_list.end(); ++i) {
         Intersection current = (*i)->intersect(r);
@@ -28,14 +97,28 @@ ObjectList::trace(Ray r) const
     return closest;
 }
 
-// trace ray r through all objects, returning true if there is any
-// intersection between r.near and r.far
-const bool
-ObjectList::probe(Ray r) const
+// trace each ray of packet p
+void
+ObjectList::trace(const RayPacket &p, Intersection hit[]) const
+{
+    if (d_accel) {
+        d_accel->tracePacket(p, hit);
+        return;
+    }
+    for(int i=0; i != p.size(); ++i)
+        hit[i] = trace(p.ray(i));
+}
+
+// trace ray r through all objects, returning any object that
+// intersects it between r.near and r.far
+const Object *
+ObjectList::occluder(Ray r) const
 {
+    if (d_accel) return d_accel->occluder(r);
+
     for(t_List::const_iterator i=d_list.begin(); i != d_list.end(); ++i) {
-        if ((*i)->intersect(r).t < r.far)
-            return true;
+        if ((*i)->occludes(r))
+            return *i;
     }
-    return false;
+    return 0;
 }
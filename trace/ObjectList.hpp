@@ -3,37 +3,98 @@
 #define OBJECTLIST_HPP
 
 // other classes we use DIRECTLY in our interface
+#include "Arena.hpp"
+#include "Box.hpp"
 #include "Intersection.hpp"
 #include "Ray.hpp"
 
 // system includes
-#include <list>
+#include <utility>
+#include <vector>
 
 // classes we only use by pointer or reference
 class Object;
+class Accelerator;
+class RayPacket;
 
 class ObjectList {
+    friend class SceneFile;         // saves objects in list order
+
+public: // public types
+    enum Accel {                    // acceleration structure choices
+        ACCEL_LIST,                 // no structure, scan whole list
+        ACCEL_FLAT,                 // scan per-type arrays
+        ACCEL_BVH,                  // bounding volume hierarchy
+        ACCEL_GRID,                 // uniform grid
+        ACCEL_AUTO                  // choose from scene layout
+    };
+
+    // structure to use for lists built from now on
+    static Accel accel;
+
 private: // private types
     // list of objects
-    typedef std::list<Object*> t_List;
+    typedef std::vector<Object*> t_List;
     t_List d_list;
+    Arena *d_arena;                 // where objects are made, or 0 for new
+
+    // acceleration structure, if built
+    Accelerator *d_accel;
+    double d_buildTime;             // seconds spent in build()
+    Box d_bounds;                   // box around all objects, set by build()
 
 public: // constructor & destructor
-    ObjectList() {}
+    // objects are made in arena if it isn't 0, which must outlive the list
+    ObjectList(Arena *arena = 0) : d_arena(arena), d_accel(0), d_buildTime(0) {}
     ~ObjectList();
 
 public:
     // Add an object to the list. Objects should be allocated with
-    // new. Objects will be deleted when this ObjectList is destroyed
+    // new, and only for a list without an arena. Objects will be deleted
+    // when this ObjectList is destroyed
     void addObject(Object *obj) { d_list.push_back(obj); }
 
+    // make a T from args where this list makes objects, and add it.
+    // Objects made in an arena are freed with it, not with the list
+    template <class T, class... Args> T *add(Args&&... args) {
+        T *obj = d_arena ? d_arena->make<T>(std::forward<Args>(args)...)
+                         : new T(std::forward<Args>(args)...);
+        d_list.push_back(obj);
+        return obj;
+    }
+
+    // build acceleration structure over the objects added so far, or
+    // use prebuilt if it isn't 0. The list owns it either way
+    // objects added later are not seen by trace or probe until rebuilt
+    void build(Accelerator *prebuilt = 0);
+
+public: // accessors
+    int size() const { return int(d_list.size()); }
+
+    // box around all objects as of the last build()
+    const Box &bounds() const { return d_bounds; }
+
+    // name of structure in use, and seconds it took to build
+    const char *accelName() const;
+    double buildTime() const { return d_buildTime; }
+
+    // is a structure in use? Only structures call the Simd kernels
+    bool accelerated() const { return d_accel != 0; }
+
 public: // computational members
     // trace ray r through all objects, returning first intersection
     const Intersection trace(Ray r) const;
 
+    // trace each ray of packet p, the same as trace() one by one
+    void trace(const RayPacket &p, Intersection hit[]) const;
+
     // trace ray r through all objects, returning true if there is an
     // interesction between r.near and r.far
-    const bool probe(Ray r) const;
+    const bool probe(Ray r) const { return occluder(r) != 0; }
+
+    // trace ray r through all objects, returning any object that
+    // intersects it between r.near and r.far, or 0 if there is none
+    const Object *occluder(Ray r) const;
 };
 
 #endif
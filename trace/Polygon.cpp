@@ -8,37 +8,91 @@
 #include "World.hpp"
 #include "Ray.hpp"
 #include "Intersection.hpp"
+#include "ObjectList.hpp"
+#include "Stats.hpp"
+#include "Triangle.hpp"
 
 void
 Polygon::addVertex(const Vec3 &v, const Vec3 &n)
 {
-    d_vertex.push_back(PolyVert(v,n));
+    // 'p'-type polygons use the face normal, so don't keep theirs
+    d_pool->addCorner(v, d_useVertexNormals ? &n : 0);
+    ++d_vertices;
 }
 
 void
 Polygon::closePolygon()
 {
     // compute normal from first two edges
-    VertexList::iterator v2 = d_vertex.begin(), v0 = v2++, v1 = v2++;
-    Vec3 e1 = v1->v - v0->v, e2 = v2->v - v1->v;
+    Vec3 e1 = vertex(1) - vertex(0), e2 = vertex(2) - vertex(1);
     d_normal = normalize(e1 ^ e2);
 
     // tangent and bitangent (2nd tangent perpendicular to 1st)
     // use edge between first and last vertex
     // avoids having to test that edge, and makes loops easier
-    d_tangent = normalize(d_vertex.front().v - d_vertex.back().v);
+    d_tangent = normalize(vertex(0) - vertex(d_vertices-1));
     d_bitangent = d_normal ^ d_tangent;
 
     // for each vertex, precompute dot product with tangent and bitangent
-    for(VertexList::iterator v = d_vertex.begin(); v != d_vertex.end(); ++v) {
-        if (!d_useVertexNormals) // replace normal for 'p'-type
-            v->n = d_normal;
-        v->v_t = dot(v->v, d_tangent);
-        v->v_b = dot(v->v, d_bitangent);
+    for(int k=0; k != d_vertices; ++k) {
+        Corner &c = d_pool->corner(d_first + k);
+        c.v_t = dot(vertex(k), d_tangent);
+        c.v_b = dot(vertex(k), d_bitangent);
     }
 
     // precompute dot product of first vertex with normal
-    d_v0_n = dot(d_vertex.front().v, d_normal);
+    d_v0_n = dot(vertex(0), d_normal);
+
+    // convex if every corner turns the same way as the first, the turns
+    // add up to one loop, and all vertices lie in the plane
+    // written so a NaN normal from a degenerate polygon fails
+    float size = length(bounds().hi - bounds().lo);
+    float turn = 0;                 // total turning angle
+    d_convex = true;
+    for(int i=0; i != d_vertices; ++i) {
+        const Vec3 &a = vertex(i);
+        const Vec3 &b = vertex((i+1) % d_vertices);
+        const Vec3 &c = vertex((i+2) % d_vertices);
+        float sinTurn = dot((b-a) ^ (c-b), d_normal);
+        if (! (sinTurn >= 0) ||
+            ! (fabsf(dot(a, d_normal) - d_v0_n) <= 1e-5f*size))
+            d_convex = false;
+        turn += atan2f(sinTurn, dot(b-a, c-b));
+    }
+    if (! (turn < 3*M_PI))
+        d_convex = false;
+}
+
+// does triangle a b c have area enough for finite edge planes? Convex
+// polygons may have collinear corners, which make such triangles
+static bool hasArea(const Vec3 &a, const Vec3 &b, const Vec3 &c)
+{
+    Vec3 e1 = b - a, e2 = c - a;
+    Vec3 fn = e1 ^ e2;
+    float area2 = dot(fn, fn);
+    return area2 > 1e-12f * dot(e1, e1) * dot(e2, e2) &&
+        1/area2 < INFINITY;
+}
+
+// replace by triangles if possible
+bool
+Polygon::addTriangles(ObjectList &list) const
+{
+    if (d_useVertexNormals) {
+        if (d_vertices != 3 || ! hasArea(vertex(0), vertex(1), vertex(2)))
+            return false;
+        list.add<Triangle>(d_appearance, vertex(0), vertex(1), vertex(2),
+                           vertexNormal(0), vertexNormal(1), vertexNormal(2));
+        return true;
+    }
+
+    // the fan's other triangles cover any without area
+    if (! d_convex) return false;
+    for(int i=2; i != d_vertices; ++i)
+        if (hasArea(vertex(0), vertex(i-1), vertex(i)))
+            list.add<Triangle>(d_appearance, vertex(0), vertex(i-1),
+                               vertex(i), d_normal);
+    return true;
 }
 
 const Intersection
@@ -48,8 +102,10 @@ Polygon::intersect(const Ray &ray) const
     float t = (d_v0_n - dot(d_normal, ray.start)) /
         dot(d_normal, ray.direction);
 
-    if (t < ray.near || t > ray.far)
+    if (t < ray.near || t > ray.far) {
+        Stats::test(Stats::POLYGON, 1, 0);
         return Intersection();  // not in ray bounds: no intersection
+    }
 
     Vec3 p = ray.start + ray.direction * t;
 
@@ -58,72 +114,115 @@ Polygon::intersect(const Ray &ray) const
 
     // check if intersection is inside or outside
     // trace ray from p along a tangent vector and count even/odd intersections
+    // the nearest edges crossed on either side are kept for the normal
     bool inside = false;
-    VertexList::const_iterator v1 = d_vertex.begin(), v0 = v1++;
-    for(; v1 != d_vertex.end(); v0 = v1, ++v1) {
+    float behind = -INFINITY, ahead = INFINITY;
+    HitAttributes hit;
+    hit.edge[0] = hit.edge[1] = -1;
+    const Corner *first = &corner(0), *v1 = first, *v0 = v1++, *end = v0 + d_vertices;
+    for(; v1 != end; v0 = v1, ++v1) {
         // does edge straddle test ray where q dot bitangent = p dot bitangent?
         float b0 = v1->v_b - p_b, b1 = p_b - v0->v_b;
         if ((b0 > 0) ^ (b1 < 0)) {
             // outbound on test ray?
             float q_t = (b0 * v0->v_t + b1 * v1->v_t)/(v1->v_b - v0->v_b);
-            if (q_t > p_t)
+            if (q_t > p_t) {
                 inside = !inside;
+                if (q_t < ahead) {
+                    ahead = q_t;
+                    hit.edge[1] = int(v0 - first);
+                }
+            }
+            else if (q_t < p_t && q_t > behind) {
+                behind = q_t;
+                hit.edge[0] = int(v0 - first);
+            }
         }
     }
 
-    if (inside) return Intersection(this,t);
+    Stats::test(Stats::POLYGON, 1, inside);
+    if (inside) {
+        hit.point = p;
+        return Intersection(this, t, hit);
+    }
 
     return Intersection();
 }
 
 const Vec3
-Polygon::appearance(const World &w, const Ray &r, float t) const {
-    Vec3 p = r.start + r.direction * t;
-
+Polygon::normal(const Vec3 &p) const {
     if (! d_useVertexNormals)
         // per-polygon normal is easy and fast
-        return d_appearance.eval(w, p, d_normal, r);
-    else {
-        // inefficiently re-test all edges to find vertex normals!
-        VertexList::const_iterator v1 = d_vertex.begin(), v0 = v1++;
-
-        // dot product of intersection with polygon tangent and bitangent
-        float p_t = dot(p, d_tangent), p_b = dot(p, d_bitangent);
-
-        float s0 = -INFINITY, s1 = INFINITY; // closest front/back intersection 
-        float b00, b01, b10, b11;       // fraction of the way along each edge
-        Vec3 n00, n01, n10, n11;        // normals at hit vertices
-
-        // re-test each edge
-        for(; v1 != d_vertex.end(); v0 = v1, ++v1) {
-            // does edge straddle test ray?
-            float b0 = v1->v_b - p_b, b1 = p_b - v0->v_b;
-            if ((b0 > 0) ^ (b1 < 0)) {
-                // convert to barycentric coordinates along edge
-                b0 /= (v1->v_b - v0->v_b);
-                b1 /= (v1->v_b - v0->v_b);
-                float s = (b0 * v0->v_t + b1 * v1->v_t) - p_t;
-
-                // closest behind test ray?
-                if (s < 0 && s > s0) {
-                    s0 = s; 
-                    b00 = b0; b01 = b1;
-                    n00 = v0->n; n01 = v1->n;
-                }
-                // closest outbound on test ray?
-                if (s > 0 && s < s1) {
-                    s1 = s; 
-                    b10 = b0; b11 = b1;
-                    n10 = v0->n; n11 = v1->n;
-                }
+        return d_normal;
+
+    // inefficiently re-test all edges to find the nearest crossings!
+    // intersect() finds them as it goes, for hitNormal()
+    HitAttributes hit;
+    hit.point = p;
+    hit.edge[0] = hit.edge[1] = -1;
+
+    // dot product of intersection with polygon tangent and bitangent
+    float p_t = dot(p, d_tangent), p_b = dot(p, d_bitangent);
+
+    float s0 = -INFINITY, s1 = INFINITY; // closest front/back intersection 
+    const Corner *first = &corner(0), *v1 = first, *v0 = v1++, *end = v0 + d_vertices;
+    for(; v1 != end; v0 = v1, ++v1) {
+        // does edge straddle test ray?
+        float b0 = v1->v_b - p_b, b1 = p_b - v0->v_b;
+        if ((b0 > 0) ^ (b1 < 0)) {
+            // convert to barycentric coordinates along edge
+            b0 /= (v1->v_b - v0->v_b);
+            b1 /= (v1->v_b - v0->v_b);
+            float s = (b0 * v0->v_t + b1 * v1->v_t) - p_t;
+
+            // closest behind test ray?
+            if (s < 0 && s > s0) {
+                s0 = s; 
+                hit.edge[0] = int(v0 - first);
+            }
+            // closest outbound on test ray?
+            if (s > 0 && s < s1) {
+                s1 = s; 
+                hit.edge[1] = int(v0 - first);
             }
         }
+    }
 
-        // interpolate between normals along test ray
-        Vec3 n0 = b00*n00 + b01*n01;
-        Vec3 n1 = b10*n10 + b11*n11;
-        Vec3 n = normalize(s1*n0 - s0*n1);
+    return hitNormal(hit);
+}
+
+// interpolate between vertex normals where the test ray from the hit
+// point crosses the nearest edges behind and ahead
+const Vec3
+Polygon::hitNormal(const HitAttributes &hit) const {
+    if (! d_useVertexNormals || hit.edge[0] < 0 || hit.edge[1] < 0)
+        return d_normal;
 
-        return d_appearance.eval(w, p, n, r);
+    // dot product of intersection with polygon tangent and bitangent
+    float p_t = dot(hit.point, d_tangent), p_b = dot(hit.point, d_bitangent);
+
+    float s[2];                     // distance along test ray to each edge
+    Vec3 n[2];                      // normal interpolated along each edge
+    for(int side=0; side<2; ++side) {
+        const Corner &v0 = corner(hit.edge[side]), &v1 = corner(hit.edge[side] + 1);
+
+        // barycentric coordinates along edge
+        float b0 = (v1.v_b - p_b) / (v1.v_b - v0.v_b);
+        float b1 = (p_b - v0.v_b) / (v1.v_b - v0.v_b);
+        s[side] = (b0 * v0.v_t + b1 * v1.v_t) - p_t;
+        n[side] = b0*d_pool->normal(v0.normal) + b1*d_pool->normal(v1.normal);
     }
+
+    // interpolate between normals along test ray
+    return normalize(s[1]*n[0] - s[0]*n[1]);
+}
+
+// box enclosing polygon vertices
+const Box
+Polygon::bounds() const
+{
+    Box b;
+    for(int k=0; k != d_vertices; ++k)
+        b.extend(vertex(k));
+    return b;
 }
@@ -5,27 +5,22 @@
 // other classes we use DIRECTLY in our interface
 #include "Object.hpp"
 #include "Vec3.hpp"
-
-// system includes necessary for the interface
-#include <vector>
+#include "VertexPool.hpp"
 
 // classes we only use by pointer or reference
 class Appearance;
 class World;
 class Ray;
+class ObjectList;
 
 class Polygon : public Object {
+    friend class SceneFile;         // saves and restores derived values
+
 private: // private data
-    struct PolyVert {
-        Vec3 v;                     // vertex
-        Vec3 n;                     // vertex normal
-        // the rest are derived values used in intersection testing
-        float v_t, v_b;             // v dot tangent and v dot bitangent
-        PolyVert(const Vec3 &_v, const Vec3 &_n) { v = _v; n = _n; }
-    };
-    typedef std::vector<PolyVert> VertexList;
-
-    VertexList d_vertex;            // list of vertices
+    typedef VertexPool::Corner Corner;
+
+    VertexPool *d_pool;             // where the vertices are
+    int d_first, d_vertices;        // run of corners in d_pool
     bool d_useVertexNormals;        // use vertex normals? (= 'pp' type)
     Vec3 d_normal;                  // face normal
     Vec3 d_tangent;                 // face tangent
@@ -34,11 +29,18 @@ private: // private data
     // derived values for intersection testing
     float d_v0_n;                   // v0 dot d_normal
 
+    // flat and convex, so it can be split into a fan of triangles
+    bool d_convex;
+
 public: // constructors
-    Polygon(int verts, const Appearance &_appearance, bool _useVertexNormals)
-        : Object(_appearance) 
+    // polygon with vertices kept in pool. Its vertices must be added
+    // before any other polygon's, since its corners are one run
+    // also allow default copy constructor, to keep a finished polygon
+    Polygon(VertexPool &pool, const Appearance &_appearance,
+            bool _useVertexNormals)
+        : Object(_appearance), d_pool(&pool), d_first(pool.corners()),
+          d_vertices(0)
     { 
-        d_vertex.reserve(verts);
         d_useVertexNormals = _useVertexNormals; 
     }
 
@@ -50,9 +52,26 @@ public: // manipulators
     // close the polygon after the last vertex
     void closePolygon();
 
+public: // accessors
+    // If this polygon can be replaced by triangles, add them to list
+    // and return true. Convex 'p' polygons become a fan of triangles
+    // sharing the polygon normal; 'pp' polygons only when they are
+    // triangles already, since splitting changes their normal interpolation
+    bool addTriangles(ObjectList &list) const;
+
 public: // object functions
     const Intersection intersect(const Ray &ray) const;
-    const Vec3 appearance(const World &w, const Ray &r, float t) const;
+    const Box bounds() const;
+    const Vec3 normal(const Vec3 &p) const;
+    const Vec3 hitNormal(const HitAttributes &hit) const;
+
+private: // helpers
+    // corner k, and its position and normal
+    const Corner &corner(int k) const { return d_pool->corner(d_first + k); }
+    const Vec3 &vertex(int k) const { return d_pool->position(corner(k).position); }
+    const Vec3 &vertexNormal(int k) const {
+        return d_useVertexNormals ? d_pool->normal(corner(k).normal) : d_normal;
+    }
 };
 
 #endif
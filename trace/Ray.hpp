@@ -15,11 +15,12 @@ public: // public data
     float far;          // farthest t to count as intersection
     int bounces;        // number of bounces allowed for ray
     float influence;    // maximum contribution of this ray to the final image
+    unsigned sample;    // pixel sample it belongs to, for random choices
 
 public: // constructors
     Ray(const Vec3 &_start, const Vec3 &_direction, 
         float _near=1e-4, float _far=INFINITY,
-        int _bounces=0, float _influence=0) 
+        int _bounces=0, float _influence=0, unsigned _sample=0) 
     {
         start = _start;
         direction = _direction;
@@ -27,6 +28,7 @@ public: // constructors
         influence = _influence;
         near = _near;
         far = _far;
+        sample = _sample;
     }
 };
 
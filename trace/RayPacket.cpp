@@ -0,0 +1,120 @@
+// implementation code for RayPacket class
+// bundles of coherent rays traced together
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "RayPacket.hpp"
+
+// other classes used directly in the implementation
+#include "Bits.hpp"
+#include "Sphere.hpp"
+
+// system includes
+#include <math.h>
+
+// packet of rays, with values that are shared or reused
+RayPacket::RayPacket(const Ray *rays, int count)
+    : d_ray(rays), d_count(count), d_coherent(count > 0)
+{
+    for(int i=0; i<count; ++i) {
+        const Ray &r = rays[i];
+        d_invDir[i] = Vec3(1/r.direction[0], 1/r.direction[1], 1/r.direction[2]);
+        float a = dot(r.direction, r.direction);
+        d_twoA[i] = 2*a;
+        d_fourA[i] = 4*a;
+
+        if (i == 0) {
+            d_invLo = d_invHi = d_invDir[0];
+            d_near = r.near;
+            d_far = r.far;
+            continue;
+        }
+
+        d_invLo = Vec3(fminf(d_invLo[0], d_invDir[i][0]),
+                       fminf(d_invLo[1], d_invDir[i][1]),
+                       fminf(d_invLo[2], d_invDir[i][2]));
+        d_invHi = Vec3(fmaxf(d_invHi[0], d_invDir[i][0]),
+                       fmaxf(d_invHi[1], d_invDir[i][1]),
+                       fmaxf(d_invHi[2], d_invDir[i][2]));
+        d_near = fminf(d_near, r.near);
+        d_far = fmaxf(d_far, r.far);
+
+        if (r.start[0] != rays[0].start[0] || r.start[1] != rays[0].start[1] ||
+            r.start[2] != rays[0].start[2])
+            d_coherent = false;
+    }
+
+    // each direction component must have one sign for all rays, and
+    // not be so small that 1/direction overflows
+    for(int a=0; a<3; ++a)
+        if (! ((d_invLo[a] > 0 && d_invHi[a] < INFINITY) ||
+               (d_invHi[a] < 0 && d_invLo[a] > -INFINITY)))
+            d_coherent = false;
+}
+
+// interval arithmetic over the range of invDir. Since every ray has the
+// same start, and each slab distance (plane - start)*invDir is monotonic
+// in invDir, the range over all rays comes from the ends of the range
+bool
+RayPacket::mayHit(const Box &b, float far) const
+{
+    const Vec3 &start = d_ray[0].start;
+    float enter = d_near, exit = far < d_far ? far : d_far;
+    for(int a=0; a<3; ++a) {
+        float nearPlane = d_invLo[a] > 0 ? b.lo[a] : b.hi[a];
+        float farPlane  = d_invLo[a] > 0 ? b.hi[a] : b.lo[a];
+        float t0 = fminf((nearPlane - start[a]) * d_invLo[a],
+                         (nearPlane - start[a]) * d_invHi[a]);
+        float t1 = fmaxf((farPlane - start[a]) * d_invLo[a],
+                         (farPlane - start[a]) * d_invHi[a]);
+        t1 *= 1.0000008f;           // same padding as Box::hit
+        if (t0 > enter) enter = t0;
+        if (t1 < exit) exit = t1;
+        if (enter > exit) return false;
+    }
+    return true;
+}
+
+// per-ray box test for each ray still in mask
+int
+RayPacket::hit(const Box &b, int mask, const float far[]) const
+{
+    int result = 0;
+    for(int m = mask; m; m &= m-1) {
+        int i = lowestBit(m);
+        float tEnter;
+        if (b.hit(d_ray[i].start, d_invDir[i], d_ray[i].near, far[i], tEnter))
+            result |= 1 << i;
+    }
+    return result;
+}
+
+// SphereGeometry::hit split into its per-sphere part, done once,
+// and its per-ray part
+void
+RayPacket::sphere(const SphereGeometry &g, int mask, const float far[],
+                  float t[]) const
+{
+    Vec3 dc = d_ray[0].start - g.center;
+    float c = dot(dc,dc) - (g.radius*g.radius);
+
+    for(int m = mask; m; m &= m-1) {
+        int i = lowestBit(m);
+        const Ray &r = d_ray[i];
+        float b = 2 * dot(r.direction, dc);
+
+        t[i] = INFINITY;
+        float discriminant = b*b - d_fourA[i]*c;
+        if (discriminant < 0) continue;
+
+        float dsq = sqrtf(discriminant);
+        float ti = (-b - dsq) / d_twoA[i];
+        if (ti > r.near && ti < far[i]) {
+            t[i] = ti;
+            continue;
+        }
+        ti = (-b + dsq) / d_twoA[i];
+        if (ti > r.near && ti < far[i])
+            t[i] = ti;
+    }
+}
@@ -0,0 +1,62 @@
+// bundles of coherent rays traced together
+#ifndef RAYPACKET_HPP
+#define RAYPACKET_HPP
+
+// other classes we use DIRECTLY in our interface
+#include "Box.hpp"
+#include "Ray.hpp"
+#include "Vec3.hpp"
+
+// classes we only use by pointer or reference
+struct SphereGeometry;
+
+// Up to SIZE rays, such as the primary rays for a block of pixels.
+// A packet is coherent if the rays share a start point and the sign of
+// each direction component. Coherent packets can be culled against a box
+// all at once, and share per-object setup. Others are traced ray by ray
+class RayPacket {
+public: // public types
+    enum { SIZE = 16 };
+
+private: // private data
+    const Ray *d_ray;               // rays, not owned by the packet
+    int d_count;                    // number of rays
+    bool d_coherent;                // shared start and direction signs
+
+    // per-ray values reused for every box and sphere
+    Vec3 d_invDir[SIZE];            // 1/direction
+    float d_twoA[SIZE], d_fourA[SIZE]; // 2 and 4 times dot(direction,direction)
+
+    // range of invDir over all rays, and of near and far
+    Vec3 d_invLo, d_invHi;
+    float d_near, d_far;
+
+public: // constructor
+    // packet of count <= SIZE rays
+    RayPacket(const Ray *rays, int count);
+
+public: // accessors
+    int size() const { return d_count; }
+    const Ray &ray(int i) const { return d_ray[i]; }
+    const Vec3 &invDir(int i) const { return d_invDir[i]; }
+    bool coherent() const { return d_coherent; }
+
+    // bit mask with a bit for every ray
+    int all() const { return (1 << d_count) - 1; }
+
+public: // computational members
+    // can any ray in this coherent packet hit box b before t = far?
+    // false answers are exact, true answers may be wrong
+    bool mayHit(const Box &b, float far) const;
+
+    // rays in mask that hit box b between near and far[i]
+    int hit(const Box &b, int mask, const float far[]) const;
+
+    // t from SphereGeometry::hit for each ray i in mask, using far[i] as
+    // the ray's far limit. Computes the same values the same way, with the
+    // per-sphere part shared by the whole coherent packet
+    void sphere(const SphereGeometry &g, int mask, const float far[],
+                float t[]) const;
+};
+
+#endif
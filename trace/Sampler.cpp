@@ -0,0 +1,208 @@
+// implementation code for Sampler class
+// low-discrepancy sample patterns for camera rays
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "Sampler.hpp"
+
+// other classes used directly in the implementation
+#include "Bits.hpp"
+
+//////////////////////////////
+// radical inverse
+
+// Reversing the digits of i one at a time takes a division per digit.
+// These tables reverse T = B^k digits at once: padded[d] is the k digits
+// of d reversed, and top[d] and topScale[d] are the significant digits of
+// d reversed and B to the number of them, for the most significant chunk.
+// r and scale come out as the same integers the digit loop builds, so
+// r/scale rounds to the same float
+template <unsigned B, unsigned T>
+class DigitTable {
+    unsigned short d_padded[T], d_top[T], d_topScale[T];
+
+public:
+    DigitTable() {
+        for(unsigned d=0; d<T; ++d) {
+            unsigned r = 0, scale = 1;
+            for(unsigned x=d; x != 0; x /= B) {
+                r = r*B + x % B;
+                scale *= B;
+            }
+            d_top[d] = (unsigned short)r;
+            d_topScale[d] = (unsigned short)scale;
+            for(; scale < T; scale *= B)        // pad with zero digits
+                r *= B;
+            d_padded[d] = (unsigned short)r;
+        }
+    }
+
+    float operator()(unsigned long long i) const {
+        unsigned long long r = 0, scale = 1;
+        for(; i >= T; i /= T) {
+            r = r*T + d_padded[i % T];
+            scale *= T;
+        }
+        return float(r*d_topScale[i] + d_top[i]) / float(scale*d_topScale[i]);
+    }
+};
+
+static const DigitTable<3, 729> s_base3;        // 3^6
+static const DigitTable<5, 625> s_base5;        // 5^4
+static const DigitTable<7, 343> s_base7;        // 7^3
+static const DigitTable<11, 1331> s_base11;     // 11^3
+
+// bits of x in the opposite order
+static inline unsigned reverseBits(unsigned x)
+{
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffu) << 8) | ((x >> 8) & 0x00ff00ffu);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x >> 4) & 0x0f0f0f0fu);
+    x = ((x & 0x33333333u) << 2) | ((x >> 2) & 0x33333333u);
+    x = ((x & 0x55555555u) << 1) | ((x >> 1) & 0x55555555u);
+    return x;
+}
+
+// base 2 reverses the significant bits
+static float radicalInverse2(unsigned x)
+{
+    if (x == 0) return 0;
+    int bits = highestBit(x) + 1;
+    unsigned long long scale = 1ull << bits;
+    return float(reverseBits(x) >> (32 - bits)) / float(scale);
+}
+
+float
+Sampler::radicalInverse(int base, long long i)
+{
+    switch(base) {
+        case 2:  return radicalInverse2(unsigned(i));
+        case 3:  return s_base3(i);
+        case 5:  return s_base5(i);
+        case 7:  return s_base7(i);
+        case 11: return s_base11(i);
+        default: return 0;
+    }
+}
+
+//////////////////////////////
+// Sobol
+
+// direction numbers for the first four Sobol dimensions, from the
+// primitive polynomials and initial values of Joe and Kuo
+struct SobolMatrices {
+    unsigned v[Sampler::DIMENSIONS][32];
+
+    SobolMatrices() {
+        static const unsigned degree[] = { 0, 1, 2, 3 };
+        static const unsigned coeff[] = { 0, 0, 1, 1 };
+        static const unsigned init[][3] = { {0,0,0}, {1,0,0}, {1,3,0}, {1,3,1} };
+        for(int k=0; k<32; ++k)                 // van der Corput
+            v[0][k] = 1u << (31-k);
+        for(int d=1; d<Sampler::DIMENSIONS; ++d) {
+            unsigned s = degree[d], a = coeff[d], m[32];
+            for(unsigned k=0; k<32; ++k) {
+                if (k < s)
+                    m[k] = init[d][k];
+                else {
+                    m[k] = m[k-s] ^ (m[k-s] << s);
+                    for(unsigned l=1; l<s; ++l)
+                        if ((a >> (s-1-l)) & 1)
+                            m[k] ^= m[k-l] << l;
+                }
+                v[d][k] = m[k] << (31-k);
+            }
+        }
+    }
+};
+static const SobolMatrices s_sobol;
+
+// dimension d of Sobol point i
+static inline unsigned sobol(unsigned i, int d)
+{
+    unsigned x = 0;
+    for(int k=0; i; i >>= 1, ++k)
+        if (i & 1) x ^= s_sobol.v[d][k];
+    return x;
+}
+
+// scramble the bits of x
+static inline unsigned hash(unsigned x)
+{
+    x ^= x >> 16; x *= 0x7feb352d;
+    x ^= x >> 15; x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+// Owen scrambling: flips each bit depending on the bits above it, using
+// Laine and Karras' permutation on the reversed bits as Burley does
+static inline unsigned owen(unsigned x, unsigned seed)
+{
+    x = reverseBits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return reverseBits(x);
+}
+
+// 32 bit fraction as a float in [0,1)
+static inline float fraction(unsigned x)
+{
+    return float(x >> 8) * (1.f / 16777216);
+}
+
+//////////////////////////////
+// Sampler
+
+Sampler::Sampler(Type type, int width, int height, int stride)
+    : d_type(type), d_width(width), d_height(height), d_stride(stride),
+      d_lineOffset(height)
+{
+    for(int j=0; j<height; ++j)
+        d_lineOffset[j] = int(radicalInverse2(unsigned(j)) * height);
+}
+
+// stream of samples for pixel (i,j)
+Sampler::Pixel
+Sampler::pixel(int i, int j) const
+{
+    Pixel p;
+    p.d_sampler = this;
+    p.d_i = i;
+    p.d_j = j;
+    p.d_base = (long long)d_height * i * d_stride + d_lineOffset[j];
+    p.d_seed = hash(hash(unsigned(i)) ^ unsigned(j));
+    return p;
+}
+
+// dimensions first and first+1 of sample n
+void
+Sampler::Pixel::get(int n, Dimension first, float &x, float &y) const
+{
+    const Sampler &s = *d_sampler;
+    if (s.d_type == HALTON) {
+        // samples past the first stride come from later rounds, numbered
+        // after every pixel's earlier rounds
+        long long round = n / s.d_stride;
+        long long ii = d_base + (long long)s.d_height *
+            (round * s.d_width * s.d_stride + n % s.d_stride);
+        if (first == LENS) {
+            x = s_base3(ii);
+            y = s_base5(ii);
+        }
+        else {
+            x = s_base7(ii);
+            y = s_base11(ii);
+        }
+        return;
+    }
+
+    // each pixel visits the points in its own order, then each
+    // dimension is scrambled its own way
+    unsigned index = owen(unsigned(n), d_seed);
+    x = fraction(owen(sobol(index, first), hash(d_seed + first)));
+    y = fraction(owen(sobol(index, first+1), hash(d_seed + first+1)));
+}
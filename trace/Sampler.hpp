@@ -0,0 +1,69 @@
+// low-discrepancy sample patterns for camera rays
+#ifndef SAMPLER_HPP
+#define SAMPLER_HPP
+
+// system includes necessary for the interface
+#include <vector>
+
+// A sampler gives every pixel its own stream of samples. Sample n of a
+// pixel is the same whenever and on whichever thread it is asked for, so
+// pixels can take samples in any order, continue where they left off, or
+// stop early.
+//
+// HALTON is a Hammersley-style pattern over the whole image: the index of
+// a sample counts rounds of stride samples, then x, then the sample
+// within the round, then the pixel's reversed y bits, and dimensions
+// come from the radical inverse of that index in bases 3, 5, 7 and 11.
+// A pixel's samples are height apart in that index, so if the height is
+// a multiple of one of those bases, every sample of a pixel has the same
+// low digit in it and covers only part of that dimension.
+// SOBOL gives each pixel the first four Sobol dimensions, shuffled and
+// Owen scrambled with hashes of the pixel so neighbors are independent
+class Sampler {
+public: // public types
+    enum Type { HALTON, SOBOL };
+
+    // pairs of dimensions a camera ray uses
+    enum Dimension { LENS = 0, FILTER = 2, DIMENSIONS = 4 };
+
+    // samples for one pixel
+    class Pixel {
+        friend class Sampler;
+        const Sampler *d_sampler;
+        int d_i, d_j;
+        long long d_base;           // HALTON: index of the pixel's first sample
+        unsigned d_seed;            // SOBOL: hash of the pixel
+    public:
+        Pixel() : d_sampler(0), d_i(0), d_j(0), d_base(0), d_seed(0) {}
+
+        int i() const { return d_i; }
+        int j() const { return d_j; }
+
+        // dimensions first and first+1 of sample n, each in [0,1)
+        void get(int n, Dimension first, float &x, float &y) const;
+    };
+
+private: // private data
+    Type d_type;
+    int d_width, d_height;
+    int d_stride;                   // HALTON: samples in one round
+    std::vector<int> d_lineOffset;  // HALTON: reversed y bits of each line
+
+public: // constructor
+    // samples for a width x height image. Halton samples come in rounds
+    // of stride samples for every pixel
+    Sampler(Type type, int width, int height, int stride);
+
+public: // accessors
+    Type type() const { return d_type; }
+
+    // stream of samples for pixel (i,j)
+    Pixel pixel(int i, int j) const;
+
+public: // pattern building blocks
+    // radical inverse of i in base 2, 3, 5, 7 or 11: digits of i mirrored
+    // around the point. The same float as the digit-by-digit loop
+    static float radicalInverse(int base, long long i);
+};
+
+#endif
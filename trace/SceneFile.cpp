@@ -0,0 +1,484 @@
+// implementation code for SceneFile class
+// compiled scenes: a binary file that loads without parsing
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "SceneFile.hpp"
+
+// other classes used directly in the implementation
+#include "BVH.hpp"
+#include "Cone.hpp"
+#include "Instance.hpp"
+#include "MappedFile.hpp"
+#include "ObjectList.hpp"
+#include "Polygon.hpp"
+#include "Sphere.hpp"
+#include "Triangle.hpp"
+#include "World.hpp"
+
+// system includes
+#include <map>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+//////////////////////////////
+// file layout
+// every record is a multiple of 4 bytes, so all of them stay aligned
+// when read in place from the mapped file
+
+static const char MAGIC[8] = { '\x89', 'T', 'S', 'C', '\r', '\n', '\x1a', '\n' };
+static const int VERSION = 2;
+static const int ORDER_MARK = 0x01020304;
+
+// start of file, followed by the material table, the lights, the
+// polygon vertex positions, normals and corners, each group with its
+// name, and the scene's own list
+struct Header {
+    char magic[8];
+    int version;
+    int byteOrder;                  // ORDER_MARK as written
+    int materials, lights, groups;  // counts
+    int positions, normals, corners;
+    int width, height;              // World's view
+    Vec3 background;
+    float hither;
+    Vec3 eye, w, u, v;
+    float dist, left, right, bottom, top;
+};
+
+// start of an object list, followed by its objects, then if the list
+// has a BVH, its nodes and the original index of each object in leaf
+// order, followed by those of objects outside the tree
+struct ListRecord {
+    int objects;
+    int nodes, prims, unbounded;    // BVH sizes, 0 if none
+};
+
+// start of every object, followed by one of the records below
+enum ObjectType { SPHERE, CONE, TRIANGLE, POLYGON, INSTANCE };
+struct ObjectRecord {
+    int type;
+    int material;                   // index in material table
+};
+
+struct TriangleRecord {
+    TriangleGeometry geom;
+    Vec3 vertex[3], vn[3];
+    int useVertexNormals;
+};
+
+struct PolygonRecord {
+    int first, vertices;            // run of corners
+    int useVertexNormals, convex;
+    Vec3 normal, tangent, bitangent;
+    float v0_n;
+};
+
+struct InstanceRecord {
+    int group;                      // index in file order of groups
+    Xform toWorld, toObject;
+};
+
+// report a file that can't be read
+static void bad()
+{
+    throw SceneError("bad compiled scene file");
+}
+
+//////////////////////////////
+// output and input state
+
+struct SceneFile::Writer {
+    FILE *f;
+    bool ok;                                // no write errors so far
+    std::map<std::string, int> material;    // index of each material's bytes
+    std::vector<Appearance> materials;      // distinct materials, in order
+    std::map<const ObjectList*, int> group; // index of each group
+    const VertexPool *vertices;             // world's, the only one saved
+
+    Writer(FILE *_f, const VertexPool *_vertices)
+        : f(_f), ok(true), vertices(_vertices) {}
+
+    // n values
+    template <class T> void put(const T *p, size_t n = 1) {
+        if (n && fwrite(p, sizeof(T), n, f) != n) ok = false;
+    }
+
+    // name padded with zeros to a multiple of 4 bytes
+    void putName(const std::string &name) {
+        int length = int(name.size());
+        put(&length);
+        char pad[4] = { 0 };
+        put(name.data(), name.size());
+        put(pad, (4 - name.size() % 4) % 4);
+    }
+
+    // add a to the table if it is new, returning its index
+    int materialOf(const Appearance &a) {
+        std::string key((const char*)&a, sizeof(a));
+        std::map<std::string, int>::iterator mi = material.find(key);
+        if (mi != material.end()) return mi->second;
+        material[key] = int(materials.size());
+        materials.push_back(a);
+        return int(materials.size()) - 1;
+    }
+};
+
+struct SceneFile::Reader {
+    const char *p, *end;                    // rest of the file
+    const Appearance *materials;
+    int materialCount;
+    std::vector<const ObjectList*> groups;
+    VertexPool *vertices;                   // world's, for polygons
+
+    Reader(const MappedFile &file, VertexPool *_vertices)
+        : p(file.data()), end(file.data() + file.size()),
+          materials(0), materialCount(0), vertices(_vertices) {}
+
+    // n values, in place in the file
+    template <class T> const T *take(size_t n = 1) {
+        if (n > size_t(end - p) / sizeof(T)) bad();
+        const T *t = (const T*)p;
+        p += n * sizeof(T);
+        return t;
+    }
+
+    // name padded to a multiple of 4 bytes
+    std::string takeName() {
+        int length = *take<int>();
+        if (length < 0) bad();
+        const char *name = take<char>((length + 3) / 4 * 4);
+        return std::string(name, length);
+    }
+
+    const Appearance &material(int i) const {
+        if (i < 0 || i >= materialCount) bad();
+        return materials[i];
+    }
+};
+
+//////////////////////////////
+// SceneFile
+
+// compiled scenes start with a byte that can't start an NFF file
+bool
+SceneFile::compiled(FILE *f)
+{
+    int c = getc(f);
+    if (c == EOF) return false;
+    ungetc(c, f);
+    return c == (unsigned char)MAGIC[0];
+}
+
+// write world to f
+bool
+SceneFile::write(const World &world, FILE *f)
+{
+    Writer out(f, &world.vertices);
+
+    // number the groups and collect distinct materials from every list
+    // before writing, since the material table comes first
+    std::vector<const ObjectList*> lists;
+    for(GroupMap::const_iterator gi=world.groups.begin();
+        gi != world.groups.end(); ++gi) {
+        out.group[gi->second] = int(lists.size());
+        lists.push_back(gi->second);
+    }
+    lists.push_back(&world.objects);
+    for(size_t i=0; i != lists.size(); ++i) {
+        const ObjectList::t_List &objects = lists[i]->d_list;
+        for(ObjectList::t_List::const_iterator oi=objects.begin();
+            oi != objects.end(); ++oi)
+            out.materialOf((*oi)->appearance());
+    }
+
+    Header h;
+    memset((void*)&h, 0, sizeof(h));   // padding too, for repeatable files
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.byteOrder = ORDER_MARK;
+    h.materials = int(out.materials.size());
+    h.lights = int(world.lights.size());
+    h.groups = int(world.groups.size());
+    h.positions = world.vertices.positions();
+    h.normals = world.vertices.normals();
+    h.corners = world.vertices.corners();
+    h.width = world.width;  h.height = world.height;
+    h.background = world.background;
+    h.hither = world.hither;
+    h.eye = world.eye;  h.w = world.w;  h.u = world.u;  h.v = world.v;
+    h.dist = world.dist;
+    h.left = world.left;  h.right = world.right;
+    h.bottom = world.bottom;  h.top = world.top;
+    out.put(&h);
+    out.put(out.materials.data(), out.materials.size());
+    out.put(world.lights.data(), world.lights.size());
+    out.put(world.vertices.d_position.values().data(), h.positions);
+    out.put(world.vertices.d_normal.values().data(), h.normals);
+    out.put(world.vertices.d_corner.data(), h.corners);
+
+    for(GroupMap::const_iterator gi=world.groups.begin();
+        gi != world.groups.end(); ++gi) {
+        out.putName(gi->first);
+        writeList(out, *gi->second);
+    }
+    writeList(out, world.objects);
+
+    return out.ok && fflush(f) == 0;
+}
+
+// write list's objects and BVH
+void
+SceneFile::writeList(Writer &out, const ObjectList &list)
+{
+    const BVH *bvh = dynamic_cast<const BVH*>(list.d_accel);
+    ListRecord lr;
+    lr.objects = list.size();
+    lr.nodes = bvh ? int(bvh->d_node.size()) : 0;
+    lr.prims = bvh ? int(bvh->d_prim.size()) : 0;
+    lr.unbounded = bvh ? int(bvh->d_unbounded.size()) : 0;
+    out.put(&lr);
+
+    for(ObjectList::t_List::const_iterator oi=list.d_list.begin();
+        oi != list.d_list.end(); ++oi) {
+        const Object *obj = *oi;
+        ObjectRecord rec;
+        rec.material = out.materialOf(obj->appearance());
+
+        if (const Sphere *s = dynamic_cast<const Sphere*>(obj)) {
+            rec.type = SPHERE;
+            out.put(&rec);
+            out.put(&s->geometry());
+        }
+        else if (const Cone *c = dynamic_cast<const Cone*>(obj)) {
+            rec.type = CONE;
+            out.put(&rec);
+            out.put(&c->geometry());
+        }
+        else if (const Triangle *t = dynamic_cast<const Triangle*>(obj)) {
+            rec.type = TRIANGLE;
+            TriangleRecord tr;
+            tr.geom = t->d_geom;
+            for(int i=0; i<3; ++i) {
+                tr.vertex[i] = t->d_vertex[i];
+                tr.vn[i] = t->d_vn[i];
+            }
+            tr.useVertexNormals = t->d_useVertexNormals;
+            out.put(&rec);
+            out.put(&tr);
+        }
+        else if (const Polygon *p = dynamic_cast<const Polygon*>(obj)) {
+            if (p->d_pool != out.vertices) {
+                out.ok = false;     // vertices aren't saved
+                continue;
+            }
+            rec.type = POLYGON;
+            PolygonRecord pr;
+            pr.first = p->d_first;
+            pr.vertices = p->d_vertices;
+            pr.useVertexNormals = p->d_useVertexNormals;
+            pr.convex = p->d_convex;
+            pr.normal = p->d_normal;
+            pr.tangent = p->d_tangent;
+            pr.bitangent = p->d_bitangent;
+            pr.v0_n = p->d_v0_n;
+            out.put(&rec);
+            out.put(&pr);
+        }
+        else if (const Instance *in = dynamic_cast<const Instance*>(obj)) {
+            rec.type = INSTANCE;
+            InstanceRecord ir;
+            ir.group = out.group[in->d_objects];
+            ir.toWorld = in->d_toWorld;
+            ir.toObject = in->d_toObject;
+            out.put(&rec);
+            out.put(&ir);
+        }
+        else
+            out.ok = false;         // no way to save it
+    }
+
+    if (bvh) {
+        out.put(bvh->d_node.data(), bvh->d_node.size());
+        for(size_t i=0; i != bvh->d_prim.size(); ++i)
+            out.put(&bvh->d_prim[i].index);
+        for(size_t i=0; i != bvh->d_unbounded.size(); ++i)
+            out.put(&bvh->d_unbounded[i].index);
+    }
+}
+
+// load world from f
+void
+SceneFile::read(World &world, FILE *f)
+{
+    MappedFile file(f);
+    Reader in(file, &world.vertices);
+
+    const Header &h = *in.take<Header>();
+    if (memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        h.version != VERSION || h.byteOrder != ORDER_MARK ||
+        h.materials < 0 || h.lights < 0 || h.groups < 0)
+        bad();
+
+    world.width = h.width;  world.height = h.height;
+    world.background = h.background;
+    world.hither = h.hither;
+    world.eye = h.eye;  world.w = h.w;  world.u = h.u;  world.v = h.v;
+    world.dist = h.dist;
+    world.left = h.left;  world.right = h.right;
+    world.bottom = h.bottom;  world.top = h.top;
+
+    in.materials = in.take<Appearance>(h.materials);
+    in.materialCount = h.materials;
+    const Light *lights = in.take<Light>(h.lights);
+    world.lights.assign(lights, lights + h.lights);
+
+    // corners are checked here so polygons need only check their runs
+    if (h.positions < 0 || h.normals < 0 || h.corners < 0)
+        bad();
+    const Vec3 *positions = in.take<Vec3>(h.positions);
+    const Vec3 *normals = in.take<Vec3>(h.normals);
+    const VertexPool::Corner *corners = in.take<VertexPool::Corner>(h.corners);
+    for(int c=0; c != h.corners; ++c) {
+        if (corners[c].position < 0 || corners[c].position >= h.positions ||
+            corners[c].normal < -1 || corners[c].normal >= h.normals)
+            bad();
+    }
+    VertexPool &vertices = world.vertices;
+    vertices.d_position.assign(positions, h.positions);
+    vertices.d_normal.assign(normals, h.normals);
+    vertices.d_corner.assign(corners, corners + h.corners);
+
+    for(int g=0; g != h.groups; ++g) {
+        std::string name = in.takeName();
+        ObjectList *group = new ObjectList(&world.arena);
+        world.groups[name] = group;
+        in.groups.push_back(group);
+        readList(in, *group);
+    }
+    readList(in, world.objects);
+}
+
+// add objects to list and build it, using the saved BVH if there is one
+// and a BVH is wanted
+void
+SceneFile::readList(Reader &in, ObjectList &list)
+{
+    const ListRecord &lr = *in.take<ListRecord>();
+    if (lr.objects < 0 || lr.nodes < 0 || lr.prims < 0 || lr.unbounded < 0)
+        bad();
+
+    for(int i=0; i != lr.objects; ++i) {
+        const ObjectRecord &rec = *in.take<ObjectRecord>();
+        const Appearance &app = in.material(rec.material);
+
+        switch(rec.type) {
+            case SPHERE:
+                {
+                    const SphereGeometry &g = *in.take<SphereGeometry>();
+                    list.add<Sphere>(app, g.center, g.radius);
+                    break;
+                }
+
+            case CONE:
+                list.add<Cone>(app, *in.take<ConeGeometry>());
+                break;
+
+            case TRIANGLE:
+                {
+                    const TriangleRecord &tr = *in.take<TriangleRecord>();
+                    Triangle t(app);
+                    t.d_geom = tr.geom;
+                    for(int v=0; v<3; ++v) {
+                        t.d_vertex[v] = tr.vertex[v];
+                        t.d_vn[v] = tr.vn[v];
+                    }
+                    t.d_useVertexNormals = tr.useVertexNormals != 0;
+                    list.add<Triangle>(t);
+                    break;
+                }
+
+            case POLYGON:
+                {
+                    const PolygonRecord &pr = *in.take<PolygonRecord>();
+                    if (pr.vertices < 3 || pr.first < 0 ||
+                        pr.first > in.vertices->corners() - pr.vertices)
+                        bad();
+                    Polygon p(*in.vertices, app, pr.useVertexNormals != 0);
+                    p.d_first = pr.first;
+                    p.d_vertices = pr.vertices;
+                    for(int k=0; k != pr.vertices; ++k)
+                        if (p.d_useVertexNormals && p.corner(k).normal < 0)
+                            bad();
+                    p.d_convex = pr.convex != 0;
+                    p.d_normal = pr.normal;
+                    p.d_tangent = pr.tangent;
+                    p.d_bitangent = pr.bitangent;
+                    p.d_v0_n = pr.v0_n;
+                    list.add<Polygon>(p);
+                    break;
+                }
+
+            case INSTANCE:
+                {
+                    // groups come before the scene, which alone has instances
+                    const InstanceRecord &ir = *in.take<InstanceRecord>();
+                    if (ir.group < 0 || ir.group >= int(in.groups.size()))
+                        bad();
+                    list.add<Instance>(in.groups[ir.group],
+                                       ir.toWorld, ir.toObject);
+                    break;
+                }
+
+            default:
+                bad();
+        }
+    }
+
+    if (lr.nodes == 0) {
+        list.build();
+        return;
+    }
+
+    const BVH::Node *node = in.take<BVH::Node>(lr.nodes);
+    const int *order = in.take<int>(lr.prims + size_t(lr.unbounded));
+    if (ObjectList::accel != ObjectList::ACCEL_AUTO &&
+        ObjectList::accel != ObjectList::ACCEL_BVH) {
+        list.build();               // some other structure was asked for
+        return;
+    }
+
+    // check the tree can only reach nodes and objects that exist, and
+    // is shallow enough to traverse. Children always come after their
+    // parent, so every node's depth is known by the time it is reached
+    std::vector<int> depth(lr.nodes, 0);
+    for(int n=0; n != lr.nodes; ++n) {
+        if (node[n].count == 0 ?
+                node[n].first <= n || node[n].first >= lr.nodes :
+                node[n].count < 0 || node[n].first < 0 ||
+                node[n].first > lr.prims - node[n].count)
+            bad();
+        if (depth[n] > BVH::STACK_SIZE - 1)
+            bad();
+        if (node[n].count == 0) {
+            int below = depth[n] + 1;
+            if (depth[n+1] < below) depth[n+1] = below;
+            if (depth[node[n].first] < below) depth[node[n].first] = below;
+        }
+    }
+
+    for(int i=0; i != lr.prims + lr.unbounded; ++i)
+        if (order[i] < 0 || order[i] >= lr.objects) bad();
+
+    std::vector<const Object*> objects(list.d_list.begin(), list.d_list.end());
+    BVH *bvh = new BVH;
+    bvh->d_node.assign(node, node + lr.nodes);
+    for(int i=0; i != lr.prims + lr.unbounded; ++i) {
+        BVH::Prim p = { objects[order[i]], order[i] };
+        (i < lr.prims ? bvh->d_prim : bvh->d_unbounded).push_back(p);
+    }
+    bvh->pack();
+    list.build(bvh);
+}
@@ -0,0 +1,36 @@
+// compiled scenes: a binary file that loads without parsing
+#ifndef SCENEFILE_HPP
+#define SCENEFILE_HPP
+
+// system includes necessary for the interface
+#include <stdio.h>
+
+// classes we only use by pointer or reference
+class World;
+class ObjectList;
+
+// A compiled scene holds the world after loading: view, lights, a table
+// of distinct materials, the polygon vertex pool, and each object list
+// with its objects' derived values and any BVH built over it. Reading
+// maps the file and copies those straight into the objects, so nothing
+// is parsed or recomputed.
+// The file is in this machine's byte order and struct layout
+class SceneFile {
+public: // reading and writing
+    // does f start with a compiled scene? f is left where it was
+    static bool compiled(FILE *f);
+
+    // write world to f, returning false on a write error
+    static bool write(const World &world, FILE *f);
+
+    // load world from compiled scene in f
+    static void read(World &world, FILE *f);
+
+private: // helpers
+    struct Writer;
+    struct Reader;
+    static void writeList(Writer &out, const ObjectList &list);
+    static void readList(Reader &in, ObjectList &list);
+};
+
+#endif
@@ -0,0 +1,55 @@
+// implementation code for ShadowCache class
+// cache of the last object to block each light
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "ShadowCache.hpp"
+
+// other classes used directly in the implementation
+#include "ObjectList.hpp"
+#include "Object.hpp"
+#include "Ray.hpp"
+#include "Stats.hpp"
+
+// system includes
+#include <atomic>
+#include <vector>
+
+// counts from threads that have ended
+static std::atomic<long> s_probes(0), s_hits(0);
+
+// everything cached for one thread
+struct ThreadCache {
+    std::vector<const Object*> last;    // last occluder for each light
+    long probes, hits;
+    ThreadCache() : probes(0), hits(0) {}
+    ~ThreadCache() { s_probes += probes; s_hits += hits; }
+};
+static thread_local ThreadCache t_cache;
+
+// is the light with index light blocked along shadow ray r?
+bool
+ShadowCache::blocked(const ObjectList &objects, int light, const Ray &r)
+{
+    ThreadCache &cache = t_cache;
+    if (light >= int(cache.last.size()))
+        cache.last.resize(light+1, 0);
+    ++cache.probes;
+    Stats::ray(Stats::SHADOW);
+
+    // try the object that blocked this light last time
+    const Object *last = cache.last[light];
+    if (last && last->occludes(r)) {
+        ++cache.hits;
+        return true;
+    }
+
+    // otherwise probe the scene, remembering any new occluder
+    const Object *occluder = objects.occluder(r);
+    if (occluder)
+        cache.last[light] = occluder;
+    return occluder != 0;
+}
+
+long ShadowCache::probes() { return s_probes + t_cache.probes; }
+long ShadowCache::hits() { return s_hits + t_cache.hits; }
@@ -0,0 +1,23 @@
+// cache of the last object to block each light
+#ifndef SHADOWCACHE_HPP
+#define SHADOWCACHE_HPP
+
+// classes we only use by pointer or reference
+class ObjectList;
+class Ray;
+
+// Neighboring shadow rays toward a light are usually blocked by the same
+// object, so each thread remembers the last occluder for each light and
+// tests it before probing the whole scene. Answers are the same as
+// ObjectList::probe
+class ShadowCache {
+public: // computational members
+    // is the light with index light blocked along shadow ray r?
+    static bool blocked(const ObjectList &objects, int light, const Ray &r);
+
+public: // statistics for the calling thread and all threads that have ended
+    static long probes();           // shadow rays tested
+    static long hits();             // shadow rays blocked by the cached object
+};
+
+#endif
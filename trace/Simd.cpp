@@ -0,0 +1,520 @@
+// implementation code for Simd class
+// one ray against blocks of spheres, cones or triangles, with SIMD when
+// available
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "Simd.hpp"
+
+// system includes
+#include <math.h>
+
+// SIMD kernels need x86 and GCC-style per-function target attributes,
+// so the rest of the program can be built for the baseline instruction set
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+//////////////////////////////
+// blocks
+
+SphereBlock::SphereBlock()
+{
+    for(int i=0; i<SIZE; ++i)
+        cx[i] = cy[i] = cz[i] = r[i] = NAN;
+}
+
+void
+SphereBlock::set(int i, const SphereGeometry &g)
+{
+    cx[i] = g.center[0]; cy[i] = g.center[1]; cz[i] = g.center[2];
+    r[i] = g.radius;
+}
+
+ConeBlock::ConeBlock()
+{
+    for(int i=0; i<SIZE; ++i)
+        bx[i] = by[i] = bz[i] = ax[i] = ay[i] = az[i] = 
+            sx[i] = sy[i] = sz[i] = rBase[i] = rDiff[i] = NAN;
+}
+
+void
+ConeBlock::set(int i, const ConeGeometry &g)
+{
+    bx[i] = g.base[0]; by[i] = g.base[1]; bz[i] = g.base[2];
+    ax[i] = g.axis[0]; ay[i] = g.axis[1]; az[i] = g.axis[2];
+    sx[i] = g.scaledAxis[0]; sy[i] = g.scaledAxis[1]; sz[i] = g.scaledAxis[2];
+    rBase[i] = g.rBase;
+    rDiff[i] = g.rDiff;
+}
+
+TriangleBlock::TriangleBlock()
+{
+    for(int i=0; i<SIZE; ++i)
+        nx[i] = ny[i] = nz[i] = v0_n[i] = ux[i] = uy[i] = uz[i] =
+            vx[i] = vy[i] = vz[i] = uOffset[i] = vOffset[i] = NAN;
+}
+
+void
+TriangleBlock::set(int i, const TriangleGeometry &g)
+{
+    nx[i] = g.normal[0]; ny[i] = g.normal[1]; nz[i] = g.normal[2];
+    v0_n[i] = g.v0_n;
+    ux[i] = g.uPlane[0]; uy[i] = g.uPlane[1]; uz[i] = g.uPlane[2];
+    vx[i] = g.vPlane[0]; vy[i] = g.vPlane[1]; vz[i] = g.vPlane[2];
+    uOffset[i] = g.uOffset;
+    vOffset[i] = g.vOffset;
+}
+
+//////////////////////////////
+// scalar kernels: rebuild each lane and call the object kernel
+
+static int spheresScalar(const SphereBlock &b, const Ray &r, float *t)
+{
+    int mask = 0;
+    for(int i=0; i<SphereBlock::SIZE; ++i) {
+        SphereGeometry g;
+        g.center = Vec3(b.cx[i], b.cy[i], b.cz[i]);
+        g.radius = b.r[i];
+        t[i] = g.hit(r);
+        if (t[i] < INFINITY) mask |= 1<<i;
+    }
+    return mask;
+}
+
+static int conesScalar(const ConeBlock &b, const Ray &r, float *t)
+{
+    int mask = 0;
+    for(int i=0; i<ConeBlock::SIZE; ++i) {
+        ConeGeometry g;
+        g.base = Vec3(b.bx[i], b.by[i], b.bz[i]);
+        g.axis = Vec3(b.ax[i], b.ay[i], b.az[i]);
+        g.scaledAxis = Vec3(b.sx[i], b.sy[i], b.sz[i]);
+        g.rBase = b.rBase[i];
+        g.rDiff = b.rDiff[i];
+        t[i] = g.hit(r);
+        if (t[i] < INFINITY) mask |= 1<<i;
+    }
+    return mask;
+}
+
+static int trianglesScalar(const TriangleBlock &b, const Ray &r, float *t)
+{
+    int mask = 0;
+    for(int i=0; i<TriangleBlock::SIZE; ++i) {
+        TriangleGeometry g;
+        g.normal = Vec3(b.nx[i], b.ny[i], b.nz[i]);
+        g.v0_n = b.v0_n[i];
+        g.uPlane = Vec3(b.ux[i], b.uy[i], b.uz[i]);
+        g.vPlane = Vec3(b.vx[i], b.vy[i], b.vz[i]);
+        g.uOffset = b.uOffset[i];
+        g.vOffset = b.vOffset[i];
+        t[i] = g.hit(r);
+        if (t[i] < INFINITY) mask |= 1<<i;
+    }
+    return mask;
+}
+
+#ifdef SIMD_X86
+
+//////////////////////////////
+// SSE kernels, four lanes at a time
+// each line mirrors the matching line of the scalar kernel
+
+__attribute__((target("sse2")))
+static int spheresSSE(const SphereBlock &s, const Ray &r, float *t)
+{
+    // per-ray values are computed once, exactly as the scalar kernel would
+    float a = dot(r.direction, r.direction);
+    __m128 dx = _mm_set1_ps(r.direction[0]);
+    __m128 dy = _mm_set1_ps(r.direction[1]);
+    __m128 dz = _mm_set1_ps(r.direction[2]);
+    __m128 two = _mm_set1_ps(2), fourA = _mm_set1_ps(4*a), twoA = _mm_set1_ps(2*a);
+    __m128 nearV = _mm_set1_ps(r.near), farV = _mm_set1_ps(r.far);
+    __m128 inf = _mm_set1_ps(INFINITY);
+    __m128 sign = _mm_set1_ps(-0.f);
+
+    int mask = 0;
+    for(int h=0; h<SphereBlock::SIZE; h+=4) {
+        // dc = r.start - center
+        __m128 dcx = _mm_sub_ps(_mm_set1_ps(r.start[0]), _mm_loadu_ps(s.cx+h));
+        __m128 dcy = _mm_sub_ps(_mm_set1_ps(r.start[1]), _mm_loadu_ps(s.cy+h));
+        __m128 dcz = _mm_sub_ps(_mm_set1_ps(r.start[2]), _mm_loadu_ps(s.cz+h));
+        __m128 rad = _mm_loadu_ps(s.r+h);
+
+        // b = 2*dot(direction, dc); c = dot(dc,dc) - radius^2
+        __m128 b = _mm_mul_ps(two, _mm_add_ps(_mm_add_ps(
+                        _mm_mul_ps(dx, dcx), _mm_mul_ps(dy, dcy)), _mm_mul_ps(dz, dcz)));
+        __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(
+                        _mm_mul_ps(dcx, dcx), _mm_mul_ps(dcy, dcy)), _mm_mul_ps(dcz, dcz)),
+                        _mm_mul_ps(rad, rad));
+
+        // negative discriminant gives NaN roots, which fail the range tests
+        __m128 disc = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(fourA, c));
+        __m128 dsq = _mm_sqrt_ps(disc);
+        __m128 nb = _mm_xor_ps(b, sign);
+
+        __m128 t1 = _mm_div_ps(_mm_sub_ps(nb, dsq), twoA);
+        __m128 ok1 = _mm_and_ps(_mm_cmpgt_ps(t1, nearV), _mm_cmplt_ps(t1, farV));
+        __m128 t2 = _mm_div_ps(_mm_add_ps(nb, dsq), twoA);
+        __m128 ok2 = _mm_and_ps(_mm_cmpgt_ps(t2, nearV), _mm_cmplt_ps(t2, farV));
+
+        // first root if in range, else second if in range, else infinity
+        __m128 res = _mm_or_ps(_mm_and_ps(ok2, t2), _mm_andnot_ps(ok2, inf));
+        res = _mm_or_ps(_mm_and_ps(ok1, t1), _mm_andnot_ps(ok1, res));
+        _mm_storeu_ps(t+h, res);
+        mask |= _mm_movemask_ps(_mm_or_ps(ok1, ok2)) << h;
+    }
+    return mask;
+}
+
+__attribute__((target("sse2")))
+static int conesSSE(const ConeBlock &k, const Ray &r, float *t)
+{
+    __m128 Dx = _mm_set1_ps(r.direction[0]);
+    __m128 Dy = _mm_set1_ps(r.direction[1]);
+    __m128 Dz = _mm_set1_ps(r.direction[2]);
+    __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1);
+    __m128 two = _mm_set1_ps(2), four = _mm_set1_ps(4);
+    __m128 nearV = _mm_set1_ps(r.near), farV = _mm_set1_ps(r.far);
+    __m128 inf = _mm_set1_ps(INFINITY);
+    __m128 sign = _mm_set1_ps(-0.f);
+
+    int mask = 0;
+    for(int h=0; h<ConeBlock::SIZE; h+=4) {
+        // E = r.start - base
+        __m128 Ex = _mm_sub_ps(_mm_set1_ps(r.start[0]), _mm_loadu_ps(k.bx+h));
+        __m128 Ey = _mm_sub_ps(_mm_set1_ps(r.start[1]), _mm_loadu_ps(k.by+h));
+        __m128 Ez = _mm_sub_ps(_mm_set1_ps(r.start[2]), _mm_loadu_ps(k.bz+h));
+        __m128 Cx = _mm_loadu_ps(k.ax+h), Cy = _mm_loadu_ps(k.ay+h), Cz = _mm_loadu_ps(k.az+h);
+        __m128 Sx = _mm_loadu_ps(k.sx+h), Sy = _mm_loadu_ps(k.sy+h), Sz = _mm_loadu_ps(k.sz+h);
+        __m128 b = _mm_loadu_ps(k.rBase+h), c = _mm_loadu_ps(k.rDiff+h);
+
+        // E_Cs = dot(E, Cs), D_Cs = dot(D, Cs)
+        __m128 E_Cs = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Ex, Sx), _mm_mul_ps(Ey, Sy)), _mm_mul_ps(Ez, Sz));
+        __m128 D_Cs = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Dx, Sx), _mm_mul_ps(Dy, Sy)), _mm_mul_ps(Dz, Sz));
+
+        // Ep = E - E_Cs*C, Dp = D - D_Cs*C
+        __m128 Epx = _mm_sub_ps(Ex, _mm_mul_ps(E_Cs, Cx));
+        __m128 Epy = _mm_sub_ps(Ey, _mm_mul_ps(E_Cs, Cy));
+        __m128 Epz = _mm_sub_ps(Ez, _mm_mul_ps(E_Cs, Cz));
+        __m128 Dpx = _mm_sub_ps(Dx, _mm_mul_ps(D_Cs, Cx));
+        __m128 Dpy = _mm_sub_ps(Dy, _mm_mul_ps(D_Cs, Cy));
+        __m128 Dpz = _mm_sub_ps(Dz, _mm_mul_ps(D_Cs, Cz));
+
+        // rb = b + E_Cs*c, ra = D_Cs*c
+        __m128 rb = _mm_add_ps(b, _mm_mul_ps(E_Cs, c));
+        __m128 ra = _mm_mul_ps(D_Cs, c);
+
+        // quadratic coefficients
+        __m128 qa = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(Dpx, Dpx), _mm_mul_ps(Dpy, Dpy)),
+                                          _mm_mul_ps(Dpz, Dpz)), _mm_mul_ps(ra, ra));
+        __m128 qb = _mm_mul_ps(two, _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(Epx, Dpx),
+                                          _mm_mul_ps(Epy, Dpy)), _mm_mul_ps(Epz, Dpz)), _mm_mul_ps(rb, ra)));
+        __m128 qc = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(Epx, Epx), _mm_mul_ps(Epy, Epy)),
+                                          _mm_mul_ps(Epz, Epz)), _mm_mul_ps(rb, rb));
+
+        // linear case, qa == 0
+        __m128 tl = _mm_div_ps(qc, qb);
+        __m128 ul = _mm_add_ps(E_Cs, _mm_mul_ps(tl, D_Cs));
+        __m128 badL = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(tl, nearV), _mm_cmpgt_ps(tl, farV)),
+                                _mm_or_ps(_mm_cmplt_ps(ul, zero), _mm_cmpge_ps(ul, one)));
+        tl = _mm_or_ps(_mm_and_ps(badL, inf), _mm_andnot_ps(badL, tl));
+
+        // quadratic case: negative discriminant gives NaN roots
+        __m128 disc = _mm_sub_ps(_mm_mul_ps(qb, qb), _mm_mul_ps(_mm_mul_ps(four, qa), qc));
+        __m128 dsq = _mm_sqrt_ps(disc);
+        __m128 nqb = _mm_xor_ps(qb, sign);
+        __m128 twoQa = _mm_mul_ps(two, qa);
+
+        __m128 t1 = _mm_div_ps(_mm_sub_ps(nqb, dsq), twoQa);
+        __m128 u1 = _mm_add_ps(E_Cs, _mm_mul_ps(t1, D_Cs));
+        __m128 bad1 = _mm_or_ps(_mm_cmplt_ps(t1, nearV),
+                                _mm_or_ps(_mm_cmplt_ps(u1, zero), _mm_cmpge_ps(u1, one)));
+        t1 = _mm_or_ps(_mm_and_ps(bad1, inf), _mm_andnot_ps(bad1, t1));
+
+        __m128 t2 = _mm_div_ps(_mm_add_ps(nqb, dsq), twoQa);
+        __m128 u2 = _mm_add_ps(E_Cs, _mm_mul_ps(t2, D_Cs));
+        __m128 bad2 = _mm_or_ps(_mm_cmplt_ps(t2, nearV),
+                                _mm_or_ps(_mm_cmplt_ps(u2, zero), _mm_cmpge_ps(u2, one)));
+        t2 = _mm_or_ps(_mm_and_ps(bad2, inf), _mm_andnot_ps(bad2, t2));
+
+        // t1 < t2 ? t1 : t2, then pick linear or quadratic answer
+        __m128 first = _mm_cmplt_ps(t1, t2);
+        __m128 tq = _mm_or_ps(_mm_and_ps(first, t1), _mm_andnot_ps(first, t2));
+        __m128 linear = _mm_cmpeq_ps(qa, zero);
+        __m128 res = _mm_or_ps(_mm_and_ps(linear, tl), _mm_andnot_ps(linear, tq));
+
+        _mm_storeu_ps(t+h, res);
+        mask |= _mm_movemask_ps(_mm_cmplt_ps(res, inf)) << h;
+    }
+    return mask;
+}
+
+__attribute__((target("sse2")))
+static int trianglesSSE(const TriangleBlock &k, const Ray &r, float *t)
+{
+    __m128 Sx = _mm_set1_ps(r.start[0]);
+    __m128 Sy = _mm_set1_ps(r.start[1]);
+    __m128 Sz = _mm_set1_ps(r.start[2]);
+    __m128 Dx = _mm_set1_ps(r.direction[0]);
+    __m128 Dy = _mm_set1_ps(r.direction[1]);
+    __m128 Dz = _mm_set1_ps(r.direction[2]);
+    __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1);
+    __m128 nearV = _mm_set1_ps(r.near), farV = _mm_set1_ps(r.far);
+    __m128 inf = _mm_set1_ps(INFINITY);
+
+    int mask = 0;
+    for(int h=0; h<TriangleBlock::SIZE; h+=4) {
+        __m128 Nx = _mm_loadu_ps(k.nx+h), Ny = _mm_loadu_ps(k.ny+h), Nz = _mm_loadu_ps(k.nz+h);
+
+        // t = (v0_n - dot(normal, start)) / dot(normal, direction)
+        __m128 N_S = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Nx, Sx), _mm_mul_ps(Ny, Sy)), _mm_mul_ps(Nz, Sz));
+        __m128 N_D = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Nx, Dx), _mm_mul_ps(Ny, Dy)), _mm_mul_ps(Nz, Dz));
+        __m128 tp = _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(k.v0_n+h), N_S), N_D);
+
+        // p = start + direction * t
+        __m128 Px = _mm_add_ps(Sx, _mm_mul_ps(tp, Dx));
+        __m128 Py = _mm_add_ps(Sy, _mm_mul_ps(tp, Dy));
+        __m128 Pz = _mm_add_ps(Sz, _mm_mul_ps(tp, Dz));
+
+        // barycentric u and v; ordered compares make NaN a miss
+        __m128 u = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                        _mm_mul_ps(Px, _mm_loadu_ps(k.ux+h)), _mm_mul_ps(Py, _mm_loadu_ps(k.uy+h))),
+                        _mm_mul_ps(Pz, _mm_loadu_ps(k.uz+h))), _mm_loadu_ps(k.uOffset+h));
+        __m128 v = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                        _mm_mul_ps(Px, _mm_loadu_ps(k.vx+h)), _mm_mul_ps(Py, _mm_loadu_ps(k.vy+h))),
+                        _mm_mul_ps(Pz, _mm_loadu_ps(k.vz+h))), _mm_loadu_ps(k.vOffset+h));
+        __m128 ok = _mm_and_ps(_mm_cmpge_ps(tp, nearV), _mm_cmple_ps(tp, farV));
+        ok = _mm_and_ps(ok, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)));
+        ok = _mm_and_ps(ok, _mm_cmple_ps(_mm_add_ps(u, v), one));
+
+        _mm_storeu_ps(t+h, _mm_or_ps(_mm_and_ps(ok, tp), _mm_andnot_ps(ok, inf)));
+        mask |= _mm_movemask_ps(ok) << h;
+    }
+    return mask;
+}
+
+//////////////////////////////
+// AVX2 kernels, all eight lanes at once
+// same as the SSE kernels line for line
+
+__attribute__((target("avx2")))
+static int spheresAVX2(const SphereBlock &s, const Ray &r, float *t)
+{
+    float a = dot(r.direction, r.direction);
+    __m256 dx = _mm256_set1_ps(r.direction[0]);
+    __m256 dy = _mm256_set1_ps(r.direction[1]);
+    __m256 dz = _mm256_set1_ps(r.direction[2]);
+    __m256 two = _mm256_set1_ps(2), fourA = _mm256_set1_ps(4*a), twoA = _mm256_set1_ps(2*a);
+    __m256 nearV = _mm256_set1_ps(r.near), farV = _mm256_set1_ps(r.far);
+    __m256 inf = _mm256_set1_ps(INFINITY);
+    __m256 sign = _mm256_set1_ps(-0.f);
+
+    __m256 dcx = _mm256_sub_ps(_mm256_set1_ps(r.start[0]), _mm256_loadu_ps(s.cx));
+    __m256 dcy = _mm256_sub_ps(_mm256_set1_ps(r.start[1]), _mm256_loadu_ps(s.cy));
+    __m256 dcz = _mm256_sub_ps(_mm256_set1_ps(r.start[2]), _mm256_loadu_ps(s.cz));
+    __m256 rad = _mm256_loadu_ps(s.r);
+
+    __m256 b = _mm256_mul_ps(two, _mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(dx, dcx), _mm256_mul_ps(dy, dcy)), _mm256_mul_ps(dz, dcz)));
+    __m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(dcx, dcx), _mm256_mul_ps(dcy, dcy)), _mm256_mul_ps(dcz, dcz)),
+                    _mm256_mul_ps(rad, rad));
+
+    __m256 disc = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(fourA, c));
+    __m256 dsq = _mm256_sqrt_ps(disc);
+    __m256 nb = _mm256_xor_ps(b, sign);
+
+    __m256 t1 = _mm256_div_ps(_mm256_sub_ps(nb, dsq), twoA);
+    __m256 ok1 = _mm256_and_ps(_mm256_cmp_ps(t1, nearV, _CMP_GT_OQ),
+                               _mm256_cmp_ps(t1, farV, _CMP_LT_OQ));
+    __m256 t2 = _mm256_div_ps(_mm256_add_ps(nb, dsq), twoA);
+    __m256 ok2 = _mm256_and_ps(_mm256_cmp_ps(t2, nearV, _CMP_GT_OQ),
+                               _mm256_cmp_ps(t2, farV, _CMP_LT_OQ));
+
+    __m256 res = _mm256_blendv_ps(inf, t2, ok2);
+    res = _mm256_blendv_ps(res, t1, ok1);
+    _mm256_storeu_ps(t, res);
+    return _mm256_movemask_ps(_mm256_or_ps(ok1, ok2));
+}
+
+__attribute__((target("avx2")))
+static int conesAVX2(const ConeBlock &k, const Ray &r, float *t)
+{
+    __m256 Dx = _mm256_set1_ps(r.direction[0]);
+    __m256 Dy = _mm256_set1_ps(r.direction[1]);
+    __m256 Dz = _mm256_set1_ps(r.direction[2]);
+    __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1);
+    __m256 two = _mm256_set1_ps(2), four = _mm256_set1_ps(4);
+    __m256 nearV = _mm256_set1_ps(r.near), farV = _mm256_set1_ps(r.far);
+    __m256 inf = _mm256_set1_ps(INFINITY);
+    __m256 sign = _mm256_set1_ps(-0.f);
+
+    __m256 Ex = _mm256_sub_ps(_mm256_set1_ps(r.start[0]), _mm256_loadu_ps(k.bx));
+    __m256 Ey = _mm256_sub_ps(_mm256_set1_ps(r.start[1]), _mm256_loadu_ps(k.by));
+    __m256 Ez = _mm256_sub_ps(_mm256_set1_ps(r.start[2]), _mm256_loadu_ps(k.bz));
+    __m256 Cx = _mm256_loadu_ps(k.ax), Cy = _mm256_loadu_ps(k.ay), Cz = _mm256_loadu_ps(k.az);
+    __m256 Sx = _mm256_loadu_ps(k.sx), Sy = _mm256_loadu_ps(k.sy), Sz = _mm256_loadu_ps(k.sz);
+    __m256 b = _mm256_loadu_ps(k.rBase), c = _mm256_loadu_ps(k.rDiff);
+
+    __m256 E_Cs = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(Ex, Sx), _mm256_mul_ps(Ey, Sy)),
+                                _mm256_mul_ps(Ez, Sz));
+    __m256 D_Cs = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(Dx, Sx), _mm256_mul_ps(Dy, Sy)),
+                                _mm256_mul_ps(Dz, Sz));
+
+    __m256 Epx = _mm256_sub_ps(Ex, _mm256_mul_ps(E_Cs, Cx));
+    __m256 Epy = _mm256_sub_ps(Ey, _mm256_mul_ps(E_Cs, Cy));
+    __m256 Epz = _mm256_sub_ps(Ez, _mm256_mul_ps(E_Cs, Cz));
+    __m256 Dpx = _mm256_sub_ps(Dx, _mm256_mul_ps(D_Cs, Cx));
+    __m256 Dpy = _mm256_sub_ps(Dy, _mm256_mul_ps(D_Cs, Cy));
+    __m256 Dpz = _mm256_sub_ps(Dz, _mm256_mul_ps(D_Cs, Cz));
+
+    __m256 rb = _mm256_add_ps(b, _mm256_mul_ps(E_Cs, c));
+    __m256 ra = _mm256_mul_ps(D_Cs, c);
+
+    __m256 qa = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(Dpx, Dpx),
+                    _mm256_mul_ps(Dpy, Dpy)), _mm256_mul_ps(Dpz, Dpz)), _mm256_mul_ps(ra, ra));
+    __m256 qb = _mm256_mul_ps(two, _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(Epx, Dpx), _mm256_mul_ps(Epy, Dpy)), _mm256_mul_ps(Epz, Dpz)),
+                    _mm256_mul_ps(rb, ra)));
+    __m256 qc = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(Epx, Epx),
+                    _mm256_mul_ps(Epy, Epy)), _mm256_mul_ps(Epz, Epz)), _mm256_mul_ps(rb, rb));
+
+    __m256 tl = _mm256_div_ps(qc, qb);
+    __m256 ul = _mm256_add_ps(E_Cs, _mm256_mul_ps(tl, D_Cs));
+    __m256 badL = _mm256_or_ps(
+        _mm256_or_ps(_mm256_cmp_ps(tl, nearV, _CMP_LT_OQ), _mm256_cmp_ps(tl, farV, _CMP_GT_OQ)),
+        _mm256_or_ps(_mm256_cmp_ps(ul, zero, _CMP_LT_OQ), _mm256_cmp_ps(ul, one, _CMP_GE_OQ)));
+    tl = _mm256_blendv_ps(tl, inf, badL);
+
+    __m256 disc = _mm256_sub_ps(_mm256_mul_ps(qb, qb), _mm256_mul_ps(_mm256_mul_ps(four, qa), qc));
+    __m256 dsq = _mm256_sqrt_ps(disc);
+    __m256 nqb = _mm256_xor_ps(qb, sign);
+    __m256 twoQa = _mm256_mul_ps(two, qa);
+
+    __m256 t1 = _mm256_div_ps(_mm256_sub_ps(nqb, dsq), twoQa);
+    __m256 u1 = _mm256_add_ps(E_Cs, _mm256_mul_ps(t1, D_Cs));
+    __m256 bad1 = _mm256_or_ps(_mm256_cmp_ps(t1, nearV, _CMP_LT_OQ),
+        _mm256_or_ps(_mm256_cmp_ps(u1, zero, _CMP_LT_OQ), _mm256_cmp_ps(u1, one, _CMP_GE_OQ)));
+    t1 = _mm256_blendv_ps(t1, inf, bad1);
+
+    __m256 t2 = _mm256_div_ps(_mm256_add_ps(nqb, dsq), twoQa);
+    __m256 u2 = _mm256_add_ps(E_Cs, _mm256_mul_ps(t2, D_Cs));
+    __m256 bad2 = _mm256_or_ps(_mm256_cmp_ps(t2, nearV, _CMP_LT_OQ),
+        _mm256_or_ps(_mm256_cmp_ps(u2, zero, _CMP_LT_OQ), _mm256_cmp_ps(u2, one, _CMP_GE_OQ)));
+    t2 = _mm256_blendv_ps(t2, inf, bad2);
+
+    __m256 tq = _mm256_blendv_ps(t2, t1, _mm256_cmp_ps(t1, t2, _CMP_LT_OQ));
+    __m256 res = _mm256_blendv_ps(tq, tl, _mm256_cmp_ps(qa, zero, _CMP_EQ_OQ));
+
+    _mm256_storeu_ps(t, res);
+    return _mm256_movemask_ps(_mm256_cmp_ps(res, inf, _CMP_LT_OQ));
+}
+
+__attribute__((target("avx2")))
+static int trianglesAVX2(const TriangleBlock &k, const Ray &r, float *t)
+{
+    __m256 Sx = _mm256_set1_ps(r.start[0]);
+    __m256 Sy = _mm256_set1_ps(r.start[1]);
+    __m256 Sz = _mm256_set1_ps(r.start[2]);
+    __m256 Dx = _mm256_set1_ps(r.direction[0]);
+    __m256 Dy = _mm256_set1_ps(r.direction[1]);
+    __m256 Dz = _mm256_set1_ps(r.direction[2]);
+    __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1);
+    __m256 nearV = _mm256_set1_ps(r.near), farV = _mm256_set1_ps(r.far);
+    __m256 inf = _mm256_set1_ps(INFINITY);
+
+    __m256 Nx = _mm256_loadu_ps(k.nx), Ny = _mm256_loadu_ps(k.ny), Nz = _mm256_loadu_ps(k.nz);
+
+    __m256 N_S = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(Nx, Sx), _mm256_mul_ps(Ny, Sy)),
+                               _mm256_mul_ps(Nz, Sz));
+    __m256 N_D = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(Nx, Dx), _mm256_mul_ps(Ny, Dy)),
+                               _mm256_mul_ps(Nz, Dz));
+    __m256 tp = _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(k.v0_n), N_S), N_D);
+
+    __m256 Px = _mm256_add_ps(Sx, _mm256_mul_ps(tp, Dx));
+    __m256 Py = _mm256_add_ps(Sy, _mm256_mul_ps(tp, Dy));
+    __m256 Pz = _mm256_add_ps(Sz, _mm256_mul_ps(tp, Dz));
+
+    __m256 u = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(Px, _mm256_loadu_ps(k.ux)), _mm256_mul_ps(Py, _mm256_loadu_ps(k.uy))),
+                    _mm256_mul_ps(Pz, _mm256_loadu_ps(k.uz))), _mm256_loadu_ps(k.uOffset));
+    __m256 v = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(Px, _mm256_loadu_ps(k.vx)), _mm256_mul_ps(Py, _mm256_loadu_ps(k.vy))),
+                    _mm256_mul_ps(Pz, _mm256_loadu_ps(k.vz))), _mm256_loadu_ps(k.vOffset));
+    __m256 ok = _mm256_and_ps(_mm256_cmp_ps(tp, nearV, _CMP_GE_OQ),
+                              _mm256_cmp_ps(tp, farV, _CMP_LE_OQ));
+    ok = _mm256_and_ps(ok, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ),
+                                         _mm256_cmp_ps(v, zero, _CMP_GE_OQ)));
+    ok = _mm256_and_ps(ok, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+
+    _mm256_storeu_ps(t, _mm256_blendv_ps(inf, tp, ok));
+    return _mm256_movemask_ps(ok);
+}
+
+#endif // SIMD_X86
+
+//////////////////////////////
+// kernel selection
+
+int (*Simd::s_spheres)(const SphereBlock &, const Ray &, float *) = spheresScalar;
+int (*Simd::s_cones)(const ConeBlock &, const Ray &, float *) = conesScalar;
+int (*Simd::s_triangles)(const TriangleBlock &, const Ray &, float *) =
+    trianglesScalar;
+Simd::Level Simd::s_level = Simd::SCALAR;
+
+// pick the best kernels before main() runs
+static struct SimdInit {
+    SimdInit() { Simd::select(Simd::detect()); }
+} s_simdInit;
+
+// best level this CPU supports
+Simd::Level
+Simd::detect()
+{
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return AVX2;
+    if (__builtin_cpu_supports("sse2")) return SSE;
+#endif
+    return SCALAR;
+}
+
+// use kernels for level, or the best supported below it
+void
+Simd::select(Level level)
+{
+    Level best = detect();
+    if (level > best) level = best;
+
+    s_level = level;
+    s_spheres = spheresScalar;
+    s_cones = conesScalar;
+    s_triangles = trianglesScalar;
+#ifdef SIMD_X86
+    if (level == SSE) {
+        s_spheres = spheresSSE;
+        s_cones = conesSSE;
+        s_triangles = trianglesSSE;
+    }
+    if (level == AVX2) {
+        s_spheres = spheresAVX2;
+        s_cones = conesAVX2;
+        s_triangles = trianglesAVX2;
+    }
+#endif
+}
+
+Simd::Level Simd::level() { return s_level; }
+
+const char *
+Simd::name(Level level)
+{
+    switch(level) {
+        case SSE:  return "sse";
+        case AVX2: return "avx2";
+        default:   return "scalar";
+    }
+}
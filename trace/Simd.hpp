@@ -0,0 +1,92 @@
+// one ray against blocks of spheres, cones or triangles, with SIMD when
+// available
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+// other classes we use DIRECTLY in our interface
+#include "Cone.hpp"
+#include "Ray.hpp"
+#include "Sphere.hpp"
+#include "Triangle.hpp"
+
+// eight spheres stored as structure-of-arrays
+// unused lanes hold NaN, which never hits
+struct SphereBlock {
+    enum { SIZE = 8 };
+    float cx[SIZE], cy[SIZE], cz[SIZE];     // center
+    float r[SIZE];                          // radius
+
+    SphereBlock();
+
+    // store sphere geometry in lane i
+    void set(int i, const SphereGeometry &g);
+};
+
+// eight cones stored as structure-of-arrays
+// unused lanes hold NaN, which never hits
+struct ConeBlock {
+    enum { SIZE = 8 };
+    float bx[SIZE], by[SIZE], bz[SIZE];     // base point
+    float ax[SIZE], ay[SIZE], az[SIZE];     // axis
+    float sx[SIZE], sy[SIZE], sz[SIZE];     // axis divided by squared length
+    float rBase[SIZE], rDiff[SIZE];         // base radius and change to apex
+
+    ConeBlock();
+
+    // store cone geometry in lane i
+    void set(int i, const ConeGeometry &g);
+};
+
+// eight triangles stored as structure-of-arrays
+// unused lanes hold NaN, which never hits
+struct TriangleBlock {
+    enum { SIZE = 8 };
+    float nx[SIZE], ny[SIZE], nz[SIZE];     // face normal
+    float v0_n[SIZE];                       // v0 dot normal
+    float ux[SIZE], uy[SIZE], uz[SIZE];     // edge plane normals
+    float vx[SIZE], vy[SIZE], vz[SIZE];
+    float uOffset[SIZE], vOffset[SIZE];     // edge plane offsets
+
+    TriangleBlock();
+
+    // store triangle geometry in lane i
+    void set(int i, const TriangleGeometry &g);
+};
+
+// Kernels fill t[i] with what the SphereGeometry, ConeGeometry or
+// TriangleGeometry hit() would return for lane i, using the same arithmetic in the same order
+// so the answers are bit-identical. NaN may stand in for INFINITY.
+// They return a bit mask of the lanes with t < INFINITY
+class Simd {
+public: // public types
+    enum Level { SCALAR, SSE, AVX2 };      // instruction set in use
+
+public: // kernel selection
+    // best level this CPU supports
+    static Level detect();
+
+    // use kernels for given level, or the best supported below it
+    static void select(Level level);
+
+    static Level level();
+    static const char *name(Level level);
+
+public: // computational members
+    static int spheres(const SphereBlock &b, const Ray &r, float t[8]) {
+        return s_spheres(b, r, t);
+    }
+    static int cones(const ConeBlock &b, const Ray &r, float t[8]) {
+        return s_cones(b, r, t);
+    }
+    static int triangles(const TriangleBlock &b, const Ray &r, float t[8]) {
+        return s_triangles(b, r, t);
+    }
+
+private: // selected kernels
+    static int (*s_spheres)(const SphereBlock &, const Ray &, float *);
+    static int (*s_cones)(const ConeBlock &, const Ray &, float *);
+    static int (*s_triangles)(const TriangleBlock &, const Ray &, float *);
+    static Level s_level;
+};
+
+#endif
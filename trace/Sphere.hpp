@@ -4,30 +4,69 @@
 
 // other classes we use DIRECTLY in the interface
 #include "Object.hpp"
+#include "Ray.hpp"
 #include "Vec3.hpp"
 
+// system includes necessary for the interface
+#include <math.h>
+
 // classes we only use by pointer or reference
 class Appearance;
 class World;
-class Ray;
+
+// sphere geometry and intersection kernel, apart from Sphere so
+// spheres can also be kept and tested in plain arrays
+struct SphereGeometry {
+    Vec3 center;
+    float radius;
+
+    // t of first intersection with r between r.near and r.far,
+    // or INFINITY if none
+    float hit(const Ray &r) const {
+        // solve p=r.start-center + t*r.direction; p*p -radius^2=0
+        float a = dot(r.direction, r.direction);
+        Vec3 dc = r.start - center;
+        float b = 2 * dot(r.direction, dc);
+        float c = dot(dc,dc) - (radius*radius);
+
+        float discriminant = b*b - 4*a*c;
+        if (discriminant < 0)       // no intersection
+            return INFINITY;
+
+        // solve quadratic equation for desired surface
+        float dsq = sqrtf(discriminant);
+        float t = (-b - dsq) / (2*a);       // first intersection within ray extent?
+        if (t > r.near && t < r.far) 
+            return t;
+
+        t = (-b + dsq) / (2*a);             // second intersection within ray extent?
+        if (t > r.near && t < r.far) 
+            return t;
+
+        return INFINITY;                    // sphere entirely behind start point
+    }
+};
 
 // sphere objects
 class Sphere : public Object {
 private: // private data
-    Vec3 d_center;
-    float d_radius;
+    SphereGeometry d_geom;
 
 public: // constructors
     Sphere(const Appearance &_appearance, const Vec3 &_center, float _radius)
         : Object(_appearance)
     {
-        d_center = _center;
-        d_radius = _radius;
+        d_geom.center = _center;
+        d_geom.radius = _radius;
     }
 
+public: // accessors
+    const SphereGeometry &geometry() const { return d_geom; }
+
 public: // object functions
     const Intersection intersect(const Ray &ray) const;
-    const Vec3 appearance(const World &w, const Ray &ray, float t) const;
+    const Box bounds() const;
+    const Vec3 normal(const Vec3 &p) const;
 };
 
 #endif
@@ -0,0 +1,139 @@
+// implementation code for Stats class
+// counts of rays and intersection tests, and time spent in each phase
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "Stats.hpp"
+
+// system includes
+#include <algorithm>
+#include <mutex>
+
+// names used in the summary and JSON
+static const char *s_rayName[] = { "primary", "shadow", "reflection", "refraction" };
+static const char *s_primName[] = { "sphere", "cone", "triangle", "polygon", "instance" };
+static const char *s_phaseName[] = { "parse", "build", "render", "write" };
+
+// counts flushed by threads
+static std::mutex s_lock;
+static long s_rays[Stats::RAY_KINDS];
+static long s_tests[Stats::PRIMITIVES], s_hits[Stats::PRIMITIVES];
+static long s_phase[Stats::PHASES];
+static int s_depth = 0;
+
+#if TRACE_STATS
+thread_local Stats::Counts Stats::t_counts;
+#endif
+
+// move the calling thread's counts to the shared totals
+void
+Stats::flush()
+{
+#if TRACE_STATS
+    Counts &c = t_counts;
+    std::lock_guard<std::mutex> hold(s_lock);
+    for(int i=0; i<RAY_KINDS; ++i) s_rays[i] += c.rays[i];
+    for(int i=0; i<PRIMITIVES; ++i) s_tests[i] += c.tests[i];
+    for(int i=0; i<PRIMITIVES; ++i) s_hits[i] += c.hits[i];
+    for(int i=0; i<PHASES; ++i) s_phase[i] += c.phase[i];
+    if (c.depth > s_depth) s_depth = c.depth;
+    c = Counts();
+#endif
+}
+
+// calling thread's counts, or none when compiled out
+const Stats::Counts &
+Stats::local()
+{
+#if TRACE_STATS
+    return t_counts;
+#else
+    static const Counts none = Counts();
+    return none;
+#endif
+}
+
+// shared totals plus the calling thread's
+long
+Stats::rays(RayKind kind)
+{
+    std::lock_guard<std::mutex> hold(s_lock);
+    return s_rays[kind] + local().rays[kind];
+}
+
+long
+Stats::tests(Primitive prim)
+{
+    std::lock_guard<std::mutex> hold(s_lock);
+    return s_tests[prim] + local().tests[prim];
+}
+
+long
+Stats::hits(Primitive prim)
+{
+    std::lock_guard<std::mutex> hold(s_lock);
+    return s_hits[prim] + local().hits[prim];
+}
+
+double
+Stats::seconds(Phase phase)
+{
+    std::lock_guard<std::mutex> hold(s_lock);
+    return (s_phase[phase] + local().phase[phase]) * 1e-9;
+}
+
+int
+Stats::depth()
+{
+    std::lock_guard<std::mutex> hold(s_lock);
+    return std::max(s_depth, local().depth);
+}
+
+// a few lines after the render
+void
+Stats::print(FILE *f)
+{
+    if (! enabled()) return;
+
+    fprintf(f, "rays:");
+    for(int i=0; i<RAY_KINDS; ++i)
+        fprintf(f, " %ld %s%s", rays(RayKind(i)), s_rayName[i],
+                i+1 < RAY_KINDS ? "," : "");
+    fprintf(f, "; deepest %d bounces\n", depth());
+
+    fprintf(f, "tests:");
+    bool any = false;
+    for(int i=0; i<PRIMITIVES; ++i) {
+        long t = tests(Primitive(i));
+        if (! t) continue;
+        fprintf(f, "%s %ld %s (%.1f%% hit)", any ? "," : "", t, s_primName[i],
+                100. * hits(Primitive(i)) / t);
+        any = true;
+    }
+    fprintf(f, "%s\n", any ? "" : " none");
+
+    fprintf(f, "time:");
+    for(int i=0; i<PHASES; ++i)
+        fprintf(f, " %s %.2f ms%s", s_phaseName[i], seconds(Phase(i)) * 1000,
+                i+1 < PHASES ? "," : "");
+    fprintf(f, "\n");
+}
+
+// everything as one JSON object
+bool
+Stats::writeJson(FILE *f)
+{
+    fprintf(f, "{\n  \"enabled\": %s,\n  \"rays\": {", enabled() ? "true" : "false");
+    for(int i=0; i<RAY_KINDS; ++i)
+        fprintf(f, "%s\"%s\": %ld", i ? ", " : "", s_rayName[i], rays(RayKind(i)));
+    fprintf(f, "},\n  \"max_depth\": %d,\n  \"intersections\": {\n", depth());
+    for(int i=0; i<PRIMITIVES; ++i)
+        fprintf(f, "    \"%s\": {\"tests\": %ld, \"hits\": %ld}%s\n", s_primName[i],
+                tests(Primitive(i)), hits(Primitive(i)),
+                i+1 < PRIMITIVES ? "," : "");
+    fprintf(f, "  },\n  \"phase_ms\": {");
+    for(int i=0; i<PHASES; ++i)
+        fprintf(f, "%s\"%s\": %.3f", i ? ", " : "", s_phaseName[i],
+                seconds(Phase(i)) * 1000);
+    return fprintf(f, "}\n}\n") > 0;
+}
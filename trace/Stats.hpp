@@ -0,0 +1,116 @@
+// counts of rays and intersection tests, and time spent in each phase
+#ifndef STATS_HPP
+#define STATS_HPP
+
+// Statistics are compiled in unless TRACE_STATS is defined as 0, which
+// leaves every counting call below empty, so they cost nothing
+#ifndef TRACE_STATS
+#define TRACE_STATS 1
+#endif
+
+// system includes necessary for the interface
+#include <chrono>
+#include <stdio.h>
+
+// Each thread counts into its own totals, plain data so counting is just
+// an add. Threads add them to the shared totals with flush() before they
+// end; totals are the shared ones plus the calling thread's
+class Stats {
+public: // public types
+    enum RayKind { PRIMARY, SHADOW, REFLECTION, REFRACTION, RAY_KINDS };
+    enum Primitive { SPHERE, CONE, TRIANGLE, POLYGON, INSTANCE, PRIMITIVES };
+    enum Phase { PARSE, BUILD, RENDER, WRITE, PHASES };
+
+    // time from construction to destruction, added to a phase
+    class Timer {
+#if TRACE_STATS
+        Phase d_phase;
+        std::chrono::steady_clock::time_point d_start;
+    public:
+        Timer(Phase phase)
+            : d_phase(phase), d_start(std::chrono::steady_clock::now()) {}
+        ~Timer() {
+            Stats::time(d_phase, std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - d_start).count());
+        }
+#else
+    public:
+        Timer(Phase) {}
+#endif
+    };
+
+private: // one thread's totals, zero to start
+    struct Counts {
+        long rays[RAY_KINDS];
+        long tests[PRIMITIVES], hits[PRIMITIVES];
+        long phase[PHASES];         // nanoseconds
+        int bounces;                // most bounces allowed a primary ray
+        int depth;                  // most taken by a secondary ray
+    };
+#if TRACE_STATS
+    static thread_local Counts t_counts;
+#endif
+    static const Counts &local();   // calling thread's, or none
+
+public: // counting
+    // a ray of kind traced, with bounces left after it. Secondary rays
+    // come from primary rays traced on the same thread
+    static void ray(RayKind kind, int bounces = 0) {
+#if TRACE_STATS
+        Counts &c = t_counts;
+        ++c.rays[kind];
+        if (kind == PRIMARY) {
+            if (bounces > c.bounces) c.bounces = bounces;
+        }
+        else if (kind != SHADOW && c.bounces - bounces > c.depth)
+            c.depth = c.bounces - bounces;
+#endif
+    }
+
+    // tests of a primitive type, hits of which were within the ray
+    static void test(Primitive prim, int tests, int hits) {
+#if TRACE_STATS
+        Counts &c = t_counts;
+        c.tests[prim] += tests;
+        c.hits[prim] += hits;
+#endif
+    }
+
+    // add seconds to the time spent in a phase
+    static void time(Phase phase, double seconds) {
+#if TRACE_STATS
+        t_counts.phase[phase] += long(seconds * 1e9);
+#endif
+    }
+
+    // move the calling thread's counts to the shared totals
+    static void flush();
+
+    // tests of every type counted on the calling thread since it last
+    // flushed, so the work between two calls can be charged to something
+    static long threadTests() {
+        long n = 0;
+#if TRACE_STATS
+        for(int i=0; i<PRIMITIVES; ++i)
+            n += t_counts.tests[i];
+#endif
+        return n;
+    }
+
+public: // totals
+    static bool enabled() { return TRACE_STATS != 0; }
+
+    static long rays(RayKind kind);
+    static long tests(Primitive prim);
+    static long hits(Primitive prim);
+    static double seconds(Phase phase);
+
+    // most bounces any ray took after its primary ray
+    static int depth();
+
+    // print a summary, or write everything as JSON
+    static void print(FILE *f);
+    static bool writeJson(FILE *f);
+};
+
+#endif
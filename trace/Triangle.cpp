@@ -0,0 +1,101 @@
+// implementation code for Triangle object class
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "Triangle.hpp"
+
+// other classes used directly in the implementation
+#include "Ray.hpp"
+#include "Stats.hpp"
+#include "Intersection.hpp"
+
+// triangle with face normal
+Triangle::Triangle(const Appearance &_appearance,
+                   const Vec3 &v0, const Vec3 &v1, const Vec3 &v2,
+                   const Vec3 &n)
+    : Object(_appearance)
+{
+    setup(v0, v1, v2, n);
+    d_useVertexNormals = false;
+    d_vn[0] = d_vn[1] = d_vn[2] = n;
+}
+
+// triangle with vertex normals
+Triangle::Triangle(const Appearance &_appearance,
+                   const Vec3 &v0, const Vec3 &v1, const Vec3 &v2,
+                   const Vec3 &n0, const Vec3 &n1, const Vec3 &n2)
+    : Object(_appearance)
+{
+    setup(v0, v1, v2, normalize((v1-v0) ^ (v2-v1)));
+    d_useVertexNormals = true;
+    d_vn[0] = n0; d_vn[1] = n1; d_vn[2] = n2;
+}
+
+// compute derived values that don't change once triangle is defined
+void
+Triangle::setup(const Vec3 &v0, const Vec3 &v1, const Vec3 &v2, const Vec3 &n)
+{
+    d_vertex[0] = v0; d_vertex[1] = v1; d_vertex[2] = v2;
+    d_geom.normal = n;
+    d_geom.v0_n = dot(v0, n);
+
+    // for p - v0 = u*e1 + v*e2 with p in the plane and face normal
+    // fn = e1^e2, u = (p-v0) dot (e2^fn)/(fn.fn), v = (p-v0) dot (fn^e1)/(fn.fn)
+    Vec3 e1 = v1 - v0, e2 = v2 - v0;
+    Vec3 fn = e1 ^ e2;
+    float scale = 1/dot(fn, fn);
+    d_geom.uPlane = (e2 ^ fn) * scale;
+    d_geom.vPlane = (fn ^ e1) * scale;
+    d_geom.uOffset = -dot(v0, d_geom.uPlane);
+    d_geom.vOffset = -dot(v0, d_geom.vPlane);
+}
+
+// ray-triangle intersection
+const Intersection
+Triangle::intersect(const Ray &r) const
+{
+    HitAttributes hit;
+    float t = d_geom.hit(r, hit.u, hit.v);
+    Stats::test(Stats::TRIANGLE, 1, t < INFINITY);
+    if (t < INFINITY) {
+        hit.point = r.start + r.direction * t;
+        return Intersection(this, t, hit);
+    }
+    return Intersection();
+}
+
+// box enclosing triangle
+const Box
+Triangle::bounds() const
+{
+    Box b;
+    for(int i=0; i<3; ++i)
+        b.extend(d_vertex[i]);
+    return b;
+}
+
+// normal at surface point p
+const Vec3
+Triangle::normal(const Vec3 &p) const
+{
+    if (! d_useVertexNormals)
+        return d_geom.normal;
+
+    HitAttributes hit;
+    hit.point = p;
+    hit.u = dot(p, d_geom.uPlane) + d_geom.uOffset;
+    hit.v = dot(p, d_geom.vPlane) + d_geom.vOffset;
+    return hitNormal(hit);
+}
+
+// normal at a hit with barycentric coordinates hit.u and hit.v
+const Vec3
+Triangle::hitNormal(const HitAttributes &hit) const
+{
+    if (! d_useVertexNormals)
+        return d_geom.normal;
+
+    // interpolate vertex normals by barycentric coordinates
+    float u = hit.u, v = hit.v;
+    return normalize((1-u-v)*d_vn[0] + u*d_vn[1] + v*d_vn[2]);
+}
@@ -0,0 +1,90 @@
+// triangle objects
+#ifndef TRIANGLE_HPP
+#define TRIANGLE_HPP
+
+// other classes we use DIRECTLY in our interface
+#include "Object.hpp"
+#include "Ray.hpp"
+#include "Vec3.hpp"
+
+// classes we only use by pointer or reference
+class Appearance;
+
+// triangle geometry and intersection kernel, apart from Triangle so
+// triangles can also be kept and tested in plain arrays
+// a point p in the plane has barycentric coordinates
+//   u = p dot uPlane + uOffset, v = p dot vPlane + vOffset
+struct TriangleGeometry {
+    Vec3 normal;                    // face normal
+    float v0_n;                     // v0 dot normal
+    Vec3 uPlane, vPlane;            // edge plane normals, scaled
+    float uOffset, vOffset;         // edge plane offsets
+
+    // t of intersection with r between r.near and r.far, or INFINITY
+    // plane first, then edges
+    float hit(const Ray &r) const {
+        float u, v;
+        return hit(r, u, v);
+    }
+
+    // the same, also setting barycentric coordinates u and v of any hit
+    float hit(const Ray &r, float &u, float &v) const {
+        // compute intersection point with plane
+        float t = (v0_n - dot(normal, r.start)) / dot(normal, r.direction);
+
+        if (t < r.near || t > r.far)
+            return INFINITY;        // not in ray bounds: no intersection
+
+        // barycentric coordinates of plane intersection, written so
+        // a NaN from degenerate edge planes is a miss
+        Vec3 p = r.start + r.direction * t;
+        u = dot(p, uPlane) + uOffset;
+        if (! (u >= 0)) return INFINITY;
+        v = dot(p, vPlane) + vOffset;
+        if (! (v >= 0) || ! (u + v <= 1)) return INFINITY;
+
+        return t;
+    }
+};
+
+// triangles, tested against precomputed edge planes rather than by
+// counting edge crossings as Polygon does
+class Triangle : public Object {
+    friend class SceneFile;         // saves and restores derived values
+
+private: // private data
+    TriangleGeometry d_geom;        // derived values used in intersection testing
+
+    bool d_useVertexNormals;        // use vertex normals? (= 'pp' type)
+    Vec3 d_vn[3];                   // vertex normals
+    Vec3 d_vertex[3];               // vertices, for bounds
+
+public: // constructors
+    // triangle with face normal n
+    Triangle(const Appearance &_appearance, 
+             const Vec3 &v0, const Vec3 &v1, const Vec3 &v2,
+             const Vec3 &n);
+
+    // triangle with vertex normals n0, n1, n2
+    Triangle(const Appearance &_appearance, 
+             const Vec3 &v0, const Vec3 &v1, const Vec3 &v2,
+             const Vec3 &n0, const Vec3 &n1, const Vec3 &n2);
+
+public: // accessors
+    const TriangleGeometry &geometry() const { return d_geom; }
+
+public: // object functions
+    const Intersection intersect(const Ray &ray) const;
+    const Box bounds() const;
+    const Vec3 normal(const Vec3 &p) const;
+    const Vec3 hitNormal(const HitAttributes &hit) const;
+
+private: // helpers
+    // triangle to be filled in by SceneFile
+    Triangle(const Appearance &_appearance) : Object(_appearance) {}
+
+    // compute derived values from vertices and face normal
+    void setup(const Vec3 &v0, const Vec3 &v1, const Vec3 &v2, const Vec3 &n);
+};
+
+#endif
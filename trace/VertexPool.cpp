@@ -0,0 +1,113 @@
+// implementation code for VertexPool class
+// polygon vertices shared by every polygon in a scene
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "VertexPool.hpp"
+
+// system includes
+#include <string.h>
+
+//////////////////////////////
+// Table
+
+// slot holding v's index, or the empty slot where it would go. The
+// table is kept at most half full, so there is always an empty slot.
+// Vectors match when their bits do, so no two distinct values merge
+size_t
+VertexPool::Table::slotOf(const Vec3 &v) const
+{
+    unsigned bits[3];
+    memcpy(bits, &v, sizeof(bits));
+    unsigned h = bits[0] * 0x9e3779b1u ^ bits[1] * 0x85ebca77u ^ bits[2] * 0xc2b2ae3du;
+    h ^= h >> 15;  h *= 0x2c1b3c6du;  h ^= h >> 12;
+
+    size_t mask = d_slot.size() - 1;
+    for(size_t s = h & mask; ; s = (s+1) & mask) {
+        int i = d_slot[s];
+        if (i < 0 || memcmp(&d_value[i], &v, sizeof(Vec3)) == 0)
+            return s;
+    }
+}
+
+// rebuild with a new number of slots, a power of two. Reinserting in
+// index order leaves every value where inserting them one by one would
+void
+VertexPool::Table::rehash(size_t slots)
+{
+    d_slot.assign(slots, -1);
+    for(size_t i=0; i != d_value.size(); ++i)
+        d_slot[slotOf(d_value[i])] = int(i);
+}
+
+// index of v, added if new
+int
+VertexPool::Table::add(const Vec3 &v)
+{
+    if (2*(d_value.size() + 1) > d_slot.size()) {
+        size_t slots = 1024;
+        while(slots < 4*(d_value.size() + 1))
+            slots *= 2;
+        rehash(slots);
+    }
+
+    size_t s = slotOf(v);
+    if (d_slot[s] < 0) {
+        d_slot[s] = int(d_value.size());
+        d_value.push_back(v);
+    }
+    return d_slot[s];
+}
+
+// Removing the most recently added value first, emptying its slot can't
+// break the search for any other: every value still present was added
+// before it, when that slot was empty, so none was placed past it
+void
+VertexPool::Table::truncate(size_t size)
+{
+    while(d_value.size() > size) {
+        if (! d_slot.empty())
+            d_slot[slotOf(d_value.back())] = -1;
+        d_value.pop_back();
+    }
+}
+
+// replace with n values already distinct, leaving the table to be built
+// if anything is added
+void
+VertexPool::Table::assign(const Vec3 *v, size_t n)
+{
+    d_value.assign(v, v + n);
+    d_slot.clear();
+}
+
+//////////////////////////////
+// VertexPool
+
+// add a corner with position v and normal n, if any
+int
+VertexPool::addCorner(const Vec3 &v, const Vec3 *n)
+{
+    Corner c;
+    c.position = d_position.add(v);
+    c.normal = n ? d_normal.add(*n) : -1;
+    c.v_t = c.v_b = 0;
+    d_corner.push_back(c);
+    return int(d_corner.size()) - 1;
+}
+
+VertexPool::Mark
+VertexPool::mark() const
+{
+    Mark m = { d_position.size(), d_normal.size(), d_corner.size() };
+    return m;
+}
+
+// remove everything added since mark
+void
+VertexPool::truncate(const Mark &mark)
+{
+    d_corner.resize(mark.corners);
+    d_normal.truncate(mark.normals);
+    d_position.truncate(mark.positions);
+}
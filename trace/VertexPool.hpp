@@ -0,0 +1,75 @@
+// polygon vertices shared by every polygon in a scene
+#ifndef VERTEXPOOL_HPP
+#define VERTEXPOOL_HPP
+
+// other classes we use DIRECTLY in our interface
+#include "Vec3.hpp"
+
+// system includes necessary for the interface
+#include <stddef.h>
+#include <vector>
+
+// Polygons keep their vertices here rather than each in its own list.
+// Every distinct position and vertex normal is stored once, however many
+// polygons share it, and each polygon's corners are a run of indices
+// into them along with the values its intersection test uses. Polygons
+// refer to their corners by index, since the arrays move as they grow
+class VertexPool {
+    friend class SceneFile;         // saves and restores the arrays
+
+public: // public types
+    // one vertex of one polygon
+    struct Corner {
+        int position;               // index of vertex position
+        int normal;                 // index of vertex normal, or -1 for 'p' type
+        float v_t, v_b;             // position dot polygon tangent and bitangent
+    };
+
+    // sizes to return to with truncate()
+    struct Mark {
+        size_t positions, normals, corners;
+    };
+
+private: // private types
+    // distinct vectors and an open addressing hash table of their
+    // indices, built when first needed
+    class Table {
+        std::vector<Vec3> d_value;
+        std::vector<int> d_slot;    // index in d_value, or -1 if empty
+        size_t slotOf(const Vec3 &v) const;
+        void rehash(size_t slots);
+    public:
+        const Vec3 &operator[](int i) const { return d_value[i]; }
+        const std::vector<Vec3> &values() const { return d_value; }
+        size_t size() const { return d_value.size(); }
+        int add(const Vec3 &v);     // index of v, added if new
+        void truncate(size_t size); // forget all added after the first size
+        void assign(const Vec3 *v, size_t n); // replace with n distinct values
+    };
+
+private: // private data
+    Table d_position, d_normal;
+    std::vector<Corner> d_corner;
+
+public: // manipulators
+    // add a corner with position v and, if it isn't 0, normal n,
+    // returning its index. Derived values are left for the polygon
+    int addCorner(const Vec3 &v, const Vec3 *n);
+
+    // remove everything added since mark was taken, most recent first,
+    // as when a polygon turns out to be replaced by triangles
+    Mark mark() const;
+    void truncate(const Mark &mark);
+
+public: // accessors
+    const Corner &corner(int i) const { return d_corner[i]; }
+    Corner &corner(int i) { return d_corner[i]; }
+    int corners() const { return int(d_corner.size()); }
+
+    const Vec3 &position(int i) const { return d_position[i]; }
+    const Vec3 &normal(int i) const { return d_normal[i]; }
+    int positions() const { return int(d_position.size()); }
+    int normals() const { return int(d_normal.size()); }
+};
+
+#endif
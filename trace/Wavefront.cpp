@@ -0,0 +1,162 @@
+// implementation code for Wavefront class
+// breadth-first renderer working on queues of rays
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "Wavefront.hpp"
+
+// other classes used directly in the implementation
+#include "Appearance.hpp"
+#include "Intersection.hpp"
+#include "RayPacket.hpp"
+#include "ShadowCache.hpp"
+#include "World.hpp"
+
+// system includes
+#include <algorithm>
+#include <utility>
+
+// spread low 21 bits of x out to every third bit
+static unsigned long long spread(unsigned long long x)
+{
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffULL;
+    x = (x | x << 16) & 0x1f0000ff0000ffULL;
+    x = (x | x << 8)  & 0x100f00f00f00f00fULL;
+    x = (x | x << 4)  & 0x10c30c30c30c30c3ULL;
+    x = (x | x << 2)  & 0x1249249249249249ULL;
+    return x;
+}
+
+Wavefront::Wavefront(const World &world, const Vec3 &eye)
+    : d_world(world), d_bounds(world.objects.bounds()), d_rays(0)
+{
+    // eye and lights may be outside the objects
+    d_bounds.extend(eye);
+    for(LightList::const_iterator li=world.lights.begin();
+        li != world.lights.end(); ++li)
+        d_bounds.extend(li->pos);
+}
+
+// queue a ray
+void
+Wavefront::add(const Ray &r, int pixel, float weight)
+{
+    Item item = { r, pixel, weight };
+    d_queue.push_back(item);
+}
+
+// three octant bits above 60 bits of Morton code for the start point
+unsigned long long
+Wavefront::key(const Ray &r) const
+{
+    unsigned long long octant =
+        (r.direction[0] < 0) | (r.direction[1] < 0) << 1 |
+        (r.direction[2] < 0) << 2;
+
+    unsigned long long morton = 0;
+    for(int a=0; a<3; ++a) {
+        float size = d_bounds.hi[a] - d_bounds.lo[a];
+        float f = size > 0 ? (r.start[a] - d_bounds.lo[a]) / size : 0;
+        f = f >= 0 ? (f <= 1 ? f : 1) : 0;      // NaN goes to 0
+        morton |= spread((unsigned long long)(f * 0xfffff)) << a;
+    }
+    return octant << 60 | morton;
+}
+
+// sort by key, ties by position
+template <class T>
+void
+Wavefront::sort(std::vector<T> &items) const
+{
+    std::vector<std::pair<unsigned long long, int> > order(items.size());
+    for(size_t i=0; i != items.size(); ++i)
+        order[i] = std::make_pair(key(items[i].ray), int(i));
+    std::sort(order.begin(), order.end());
+
+    std::vector<T> sorted;
+    sorted.reserve(items.size());
+    for(size_t i=0; i != order.size(); ++i)
+        sorted.push_back(items[order[i].second]);
+    items.swap(sorted);
+}
+
+// run passes until no rays are left
+void
+Wavefront::run(Vec3 image[])
+{
+    std::vector<Item> rays;
+    while(! d_queue.empty()) {
+        rays.swap(d_queue);
+        d_queue.clear();
+        sort(rays);
+        pass(rays, image);
+    }
+}
+
+// one pass: bulk intersect, shade, then shadow test
+void
+Wavefront::pass(std::vector<Item> &rays, Vec3 image[])
+{
+    const World &world = d_world;
+    d_rays += long(rays.size());
+
+    // intersect in sorted order, in packets that are coherent where
+    // neighbors in the queue share a start point
+    std::vector<Intersection> hits(rays.size());
+    std::vector<Ray> packet;
+    packet.reserve(RayPacket::SIZE);
+    for(size_t i=0; i < rays.size(); i += RayPacket::SIZE) {
+        packet.clear();
+        for(size_t j=i; j < rays.size() && j < i+RayPacket::SIZE; ++j)
+            packet.push_back(rays[j].ray);
+        world.objects.trace(RayPacket(&packet[0], int(packet.size())), &hits[i]);
+    }
+
+    // shade: misses get background, hits queue their shadow and secondary rays
+    d_shadow.clear();
+    for(size_t i=0; i != rays.size(); ++i) {
+        const Item &item = rays[i];
+        const Ray &r = item.ray;
+        if (! hits[i].object()) {
+            image[item.pixel] = image[item.pixel] + item.weight * world.background;
+            continue;
+        }
+
+        Vec3 p, n;
+        const Appearance &app = hits[i].surface(r, p, n);
+        Vec3 V = -normalize(r.direction);
+
+        int light = 0;
+        for (LightList::const_iterator li=world.lights.begin();
+             li != world.lights.end(); ++li, ++light) {
+            Vec3 col;
+            app.addLight(col, *li, p, n, V);
+            if (col[0] == 0 && col[1] == 0 && col[2] == 0)
+                continue;                       // nothing to shadow
+            col = item.weight * col;
+
+            if (World::effects & World::SHADOW) {
+                ShadowItem s = { Ray(p, li->pos - p, 1e-4f, 1.f), light,
+                                 item.pixel, col };
+                d_shadow.push_back(s);
+            }
+            else
+                image[item.pixel] = image[item.pixel] + col;
+        }
+
+        Ray sr = r;
+        if (app.reflection(r, p, n, sr))
+            add(sr, item.pixel, item.weight * app.ks);
+        if (app.refraction(r, p, n, V, sr))
+            add(sr, item.pixel, item.weight * app.kt);
+    }
+
+    // shadow rays, grouped by where they start and which way they go
+    sort(d_shadow);
+    for(size_t i=0; i != d_shadow.size(); ++i) {
+        const ShadowItem &s = d_shadow[i];
+        if (! ShadowCache::blocked(world.objects, s.light, s.ray))
+            image[s.pixel] = image[s.pixel] + s.color;
+    }
+}
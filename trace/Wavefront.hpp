@@ -0,0 +1,72 @@
+// breadth-first renderer working on queues of rays
+#ifndef WAVEFRONT_HPP
+#define WAVEFRONT_HPP
+
+// other classes we use DIRECTLY in our interface
+#include "Box.hpp"
+#include "Ray.hpp"
+#include "Vec3.hpp"
+
+// system includes necessary for the interface
+#include <vector>
+
+// classes we only use by pointer or reference
+class World;
+
+// Instead of following each ray's reflections depth first inside
+// Appearance::eval, rays wait in a queue. Each pass sorts the queue by
+// direction octant and start point, intersects the whole queue, shades
+// every hit and queues the shadow and secondary rays it needs. Shadow
+// rays are sorted and tested as a batch, then the next pass starts
+//
+// Each ray carries the pixel it belongs to and the weight of its color
+// in that pixel, so the image is a sum of weighted colors in place of
+// eval's nested sums. It matches the recursive renderer up to rounding
+class Wavefront {
+private: // private types
+    struct Item {                   // ray waiting to be traced
+        Ray ray;
+        int pixel;                  // pixel to add color into
+        float weight;               // fraction of color to add
+    };
+    struct ShadowItem {             // light waiting for a shadow test
+        Ray ray;
+        int light;                  // index in world.lights
+        int pixel;
+        Vec3 color;                 // weighted color if not in shadow
+    };
+
+private: // private data
+    const World &d_world;
+    Box d_bounds;                   // scene box, for sorting by start point
+    std::vector<Item> d_queue;      // rays for the next pass
+    std::vector<ShadowItem> d_shadow; // shadow rays from the current pass
+    long d_rays;                    // rays traced so far, not counting shadows
+
+public: // constructor
+    // tracer for world, viewed from eye
+    Wavefront(const World &world, const Vec3 &eye);
+
+public: // accessors
+    long rays() const { return d_rays; }
+
+public: // computational members
+    // queue ray r, adding weight times its color to image[pixel]
+    void add(const Ray &r, int pixel, float weight);
+
+    // trace everything queued, and everything it spawns, adding
+    // color into image
+    void run(Vec3 image[]);
+
+private: // helpers
+    // sort key: direction octant, then start point along a Morton curve
+    unsigned long long key(const Ray &r) const;
+
+    // sort items by key, keeping the original order for equal keys
+    template <class T> void sort(std::vector<T> &items) const;
+
+    // intersect and shade one pass worth of rays
+    void pass(std::vector<Item> &rays, Vec3 image[]);
+};
+
+#endif
@@ -0,0 +1,136 @@
+// implementation code for WorkPool class
+// threads sharing out numbered pieces of work
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "WorkPool.hpp"
+
+// other classes used directly in the implementation
+#include "Stats.hpp"
+
+// system includes
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// one thread's items, locked for every change since thieves use it too
+struct WorkQueue {
+    std::mutex lock;
+    std::deque<int> items;
+};
+
+// next item for thread self: its own first, else one stolen from the back
+// of the next busy queue. Returns false once every queue is empty
+static bool nextItem(WorkQueue queues[], int n, int self, int &item)
+{
+    {
+        std::lock_guard<std::mutex> hold(queues[self].lock);
+        if (! queues[self].items.empty()) {
+            item = queues[self].items.front();
+            queues[self].items.pop_front();
+            return true;
+        }
+    }
+
+    for(int k=1; k<n; ++k) {
+        WorkQueue &victim = queues[(self+k) % n];
+        std::lock_guard<std::mutex> hold(victim.lock);
+        if (! victim.items.empty()) {
+            item = victim.items.back();
+            victim.items.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+WorkPool::WorkPool(int threads)
+    : d_threads(threads), d_round(0), d_busy(0), d_stop(false),
+      d_queues(0), d_active(0), d_work(0)
+{
+    if (d_threads <= 0)
+        d_threads = int(std::thread::hardware_concurrency());
+    if (d_threads <= 0)
+        d_threads = 1;
+}
+
+WorkPool::~WorkPool()
+{
+    {
+        std::lock_guard<std::mutex> hold(d_lock);
+        d_stop = true;
+    }
+    d_start.notify_all();
+    for(size_t t=0; t != d_workers.size(); ++t)
+        d_workers[t].join();
+}
+
+// deal items out to one queue per thread, then work until all are empty
+// queues only shrink, so once a thread finds them all empty it is done
+void
+WorkPool::run(int count, const std::function<void(int)> &work)
+{
+    int n = d_threads < count ? d_threads : count;
+    if (n <= 1) {
+        for(int i=0; i<count; ++i)
+            work(i);
+        return;
+    }
+
+    std::vector<WorkQueue> queues(n);
+    for(int i=0; i<count; ++i)
+        queues[i % n].items.push_back(i);
+
+    {
+        std::lock_guard<std::mutex> hold(d_lock);
+        while(int(d_workers.size()) < n-1)
+            d_workers.push_back(std::thread(&WorkPool::worker, this,
+                                            int(d_workers.size()) + 1));
+        d_queues = &queues[0];
+        d_active = n;
+        d_work = &work;
+        d_busy = int(d_workers.size());
+        ++d_round;
+    }
+    d_start.notify_all();
+
+    int item;
+    while(nextItem(&queues[0], n, 0, item))
+        work(item);
+
+    std::unique_lock<std::mutex> hold(d_lock);
+    d_done.wait(hold, [this] { return d_busy == 0; });
+}
+
+// wait for each run, and take part if it has a queue for this thread
+void
+WorkPool::worker(int self)
+{
+    unsigned seen = 0;
+    for(;;) {
+        WorkQueue *queues;
+        int n;
+        const std::function<void(int)> *work;
+        {
+            std::unique_lock<std::mutex> hold(d_lock);
+            d_start.wait(hold, [&] { return d_stop || d_round != seen; });
+            if (d_stop) return;
+            seen = d_round;
+            queues = d_queues;
+            n = d_active;
+            work = d_work;
+        }
+
+        if (self < n) {
+            int item;
+            while(nextItem(queues, n, self, item))
+                (*work)(item);
+            Stats::flush();         // so the caller's totals include them
+        }
+
+        std::lock_guard<std::mutex> hold(d_lock);
+        if (--d_busy == 0)
+            d_done.notify_all();
+    }
+}
@@ -0,0 +1,61 @@
+// threads sharing out numbered pieces of work
+#ifndef WORKPOOL_HPP
+#define WORKPOOL_HPP
+
+// system includes necessary for the interface
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// classes we only use by pointer or reference
+struct WorkQueue;
+
+// Runs work(i) for every i in a range on a number of threads. Each thread
+// starts with its own queue of items, dealt out in turn so nearby items
+// go to different threads. A thread works from the front of its queue
+// and, when that is empty, steals from the back of another thread's
+// queue, so threads that get cheap items help out the rest.
+// Threads are started the first time a run needs them, then wait for
+// the next run until the pool is destroyed
+class WorkPool {
+private: // private data
+    int d_threads;                  // threads, including the caller
+    std::vector<std::thread> d_workers; // the rest, started as needed
+
+    std::mutex d_lock;              // for the rest
+    std::condition_variable d_start; // a run started, or stopping
+    std::condition_variable d_done; // a worker finished its part
+    unsigned d_round;               // runs started, so workers see a new one
+    int d_busy;                     // workers not done with this run
+    bool d_stop;                    // workers should end
+
+    // the run in progress
+    WorkQueue *d_queues;            // one for each thread taking part
+    int d_active;                   // threads taking part
+    const std::function<void(int)> *d_work;
+
+public: // constructor and destructor
+    // pool of given size; 0 means one thread for each core
+    WorkPool(int threads);
+
+    // end and join the threads
+    ~WorkPool();
+
+public: // accessors
+    int threads() const { return d_threads; }
+
+public: // computational members
+    // call work(i) once for each i in [0,count), returning when all are
+    // done. The calling thread is one of the workers. One run at a time
+    void run(int count, const std::function<void(int)> &work);
+
+private: // helpers
+    void worker(int self);          // thread self, from 1, between runs
+
+    WorkPool(const WorkPool &);     // not copyable
+    void operator=(const WorkPool &);
+};
+
+#endif
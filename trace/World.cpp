@@ -10,12 +10,19 @@
 #include "Polygon.hpp"
 #include "Sphere.hpp"
 #include "Cone.hpp"
+#include "Instance.hpp"
 #include "Appearance.hpp"
+#include "NffFile.hpp"
+#include "SceneFile.hpp"
+#include "Stats.hpp"
+#include "Xform.hpp"
 
 // system includes
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include <string>
 
 #ifdef _WIN32
 #pragma warning( disable: 4996 )
@@ -27,177 +34,215 @@ unsigned int World::effects = ~0;
 // report an error
 static void err(int lineNum)
 {
-    fprintf(stderr, "NFF file error at line %d\n", lineNum);
-    exit(1);
+    char why[64];
+    snprintf(why, sizeof(why), "NFF file error at line %d", lineNum);
+    throw SceneError(why);
 }
 
-// read a line
-static char *readLine(FILE *f, char line[1024], int &lineNumber)
+// read input file, compiled or NFF
+World::World(FILE *f, int threads)
+    : objects(&arena)
 {
-    ++lineNumber;
-    return fgets(line, 1024, f);
+    Stats::Timer load(Stats::PARSE);
+    double built = Stats::seconds(Stats::BUILD);
+
+    // the destructor won't run to delete groups read before an error
+    try {
+        if (SceneFile::compiled(f))
+            SceneFile::read(*this, f);
+        else
+            readNff(f, threads);
+    }
+    catch(...) {
+        for(GroupMap::iterator gi=groups.begin(); gi!=groups.end(); ++gi)
+            delete gi->second;
+        throw;
+    }
+
+    // time building acceleration structures isn't parsing
+    Stats::time(Stats::PARSE, built - Stats::seconds(Stats::BUILD));
 }
 
-// read input file
-World::World(FILE *f)
+// read NFF file
+void
+World::readNff(FILE *f, int threads)
 {
-    char line[1024];                    // line of file
-    int lineNumber = 0;                 // current line for error reporting
+    NffFile file(f, threads);
     Appearance app;                     // current object appearance
+    ObjectList *target = &objects;      // objects go here: scene or group
+
+    for(int ci=0; ci != file.chunks(); ++ci) {
+        const NffFile::Chunk &chunk = file.chunk(ci);
+        for(size_t ri=0; ri != chunk.records.size(); ++ri) {
+            const NffFile::Record &rec = chunk.records[ri];
+            const float *num = rec.count ? &chunk.numbers[rec.first] : 0;
+
+            switch(rec.type) {
+                case 'v':               // view point
+                    {
+                        // view parameters: from, at, up, angle, hither, resolution
+                        eye = Vec3(num[0], num[1], num[2]);
+                        Vec3 vAt(num[3], num[4], num[5]);
+                        Vec3 vUp(num[6], num[7], num[8]);
+                        float angle = num[9];
+                        hither = num[10];
+                        width = int(num[11]);
+                        height = int(num[12]);
+
+                        // compute view basis
+                        w = eye - vAt;
+                        dist = length(w);
+                        w = normalize(w);
+                        u = normalize(vUp ^ w);
+                        v = w ^ u;
+
+                        // solve w/2d = tan(fov/2), where w=2 and fov must be in radians
+                        float t = float(tan(angle * M_PI/360));
+                        top = dist*t;
+                        bottom = -top;
+                        right = top * width / height;
+                        left = -right;
+
+                        break;
+                    }
 
-    while(readLine(f, line, lineNumber)) {
-        switch(line[0]) {
-            case ' ': case '\t':        // blank lines and comments
-            case '\f': case '\r': case '\n':
-            case '#': case '\0':
-                break;
-
-            case 'v':                   // view point
-                {
-                    // read view parameters
-                    Vec3 vAt, vUp;
-                    float angle;
-                    readLine(f, line, lineNumber);
-                    if (sscanf(line,"from %f %f %f", &eye[0], &eye[1], &eye[2]) != 3) 
-                        err(lineNumber);
-
-                    readLine(f, line, lineNumber);
-                    if (sscanf(line,"at %f %f %f", &vAt[0], &vAt[1], &vAt[2]) != 3)
-                        err(lineNumber);
-
-                    readLine(f, line, lineNumber);
-                    if (sscanf(line,"up %f %f %f", &vUp[0], &vUp[1], &vUp[2]) != 3) 
-                        err(lineNumber);
-
-                    readLine(f, line, lineNumber);
-                    if (sscanf(line,"angle %f", &angle) != 1) 
-                        err(lineNumber);
-
-                    readLine(f, line, lineNumber);
-                    if (sscanf(line,"hither %f", &hither) != 1) 
-                        err(lineNumber);
-
-                    readLine(f, line, lineNumber);
-                    if (sscanf(line, "resolution %d %d", &width, &height) != 2) 
-                        err(lineNumber);
-
-                    // compute view basis
-                    w = eye - vAt;
-                    dist = length(w);
-                    w = normalize(w);
-                    u = normalize(vUp ^ w);
-                    v = w ^ u;
-
-                    // solve w/2d = tan(fov/2), where w=2 and fov must be in radians
-                    float t = float(tan(angle * M_PI/360));
-                    top = dist*t;
-                    bottom = -top;
-                    right = top * width / height;
-                    left = -right;
-
+                case 'b':               // background
+                    background = Vec3(num[0], num[1], num[2]);
                     break;
-                }
-
-            case 'b':                   // background
-                {
-                    if (sscanf(line,"b %f %f %f",
-                                &background[0], &background[1], &background[2]) != 3) 
-                        err(lineNumber);
 
-                    break;
-                }
+                case 'l':               // light, color defaults to white
+                    {
+                        Light light;
+                        for(int i=0; i<rec.count; ++i) {
+                            if (i < 3) light.pos[i] = num[i];
+                            else light.col[i-3] = num[i];
+                        }
+                        lights.push_back(light);
 
-            case 'l':                   // light
-                {
-                    Light light;
-                    if (sscanf(line,"l %f %f %f %f %f %f",
-                                &light.pos[0], &light.pos[1], &light.pos[2],
-                                &light.col[0], &light.col[1], &light.col[2]) < 3)
-                        err(lineNumber);
-                    lights.push_back(light);
+                        break;
+                    }
 
+                case 'f':               // fill/material properties
+                    app.color = Vec3(num[0], num[1], num[2]);
+                    app.kd = num[3]; app.ks = num[4]; app.e = num[5];
+                    app.kt = num[6]; app.ir = num[7];
                     break;
-                }
 
-            case 'f':                   // fill/material properties
-                {
-                    if (sscanf(line,"f %f %f %f %f %f %f %f %f",
-                                &app.color[0], &app.color[1], &app.color[2],
-                                &app.kd, &app.ks, &app.e, &app.kt, &app.ir) != 8) 
-                        err(lineNumber);
+                case 'c':               // cone or cylinder
+                    {
+                        Vec3 base(num[0], num[1], num[2]);
+                        Vec3 apex(num[4], num[5], num[6]);
+                        if (World::effects & World::CONES)
+                            target->add<Cone>(app, base, num[3], apex, num[7]);
+
+                        break;
+                    }
 
+                case 's':               // sphere
+                    if (World::effects & World::SPHERES)
+                        target->add<Sphere>(app,
+                                    Vec3(num[0], num[1], num[2]), num[3]);
                     break;
-                }
 
-            case 'c':                   // cone or cylinder
-                {
-                    Vec3 base, apex;                      // location of base and apex
-                    float rBase, rApex;                   // radius at base and apex
+                case 'p':               // p or pp polygon primitives
+                    {
+                        // polygon primitive w/ type, six numbers per vertex
+                        // built in place first, and only kept, vertices
+                        // and all, if triangles can't replace it
+                        int nv = rec.count / 6;
+                        VertexPool::Mark mark = vertices.mark();
+                        Polygon poly(vertices, app, rec.pp);
+                        for(int i=0; i<nv; ++i) {
+                            const float *vn = num + 6*i;
+                            poly.addVertex(Vec3(vn[0], vn[1], vn[2]),
+                                           Vec3(vn[3], vn[4], vn[5]));
+                        }
+
+                        poly.closePolygon();
+
+                        // use triangles instead where possible
+                        if (! (World::effects & World::POLYGONS) ||
+                                poly.addTriangles(*target))
+                            vertices.truncate(mark);
+                        else
+                            target->add<Polygon>(poly);
+
+                        break;
+                    }
 
-                    if (sscanf(line,"c %f %f %f %f %f %f %f %f",
-                                &base[0], &base[1], &base[2], &rBase,
-                                &apex[0], &apex[1], &apex[2], &rApex) != 8) 
-                        err(lineNumber);
+                case 'g':               // start of named object group
+                    {
+                        // objects up to "end" go in the group
+                        std::string name(rec.name, rec.nameLength);
+                        if (target != &objects || groups.count(name))
+                            err(rec.line);
 
-                    if (World::effects & World::CONES)
-                        objects.addObject(new Cone(app, base, rBase, apex, rApex));
+                        target = new ObjectList(&arena);
+                        groups[name] = target;
 
-                    break;
-                }
+                        break;
+                    }
 
-            case 's':                   // sphere
-                {
-                    Vec3 center;
-                    float radius;
-                    if (sscanf(line,"s %f %f %f %f",
-                                &center[0], &center[1], &center[2], &radius) != 4) 
-                        err(lineNumber);
+                case 'e':               // end of object group
+                    if (target == &objects)
+                        err(rec.line);
 
-                    if (World::effects & World::SPHERES)
-                        objects.addObject(new Sphere(app, center, radius));
+                    target->build();
+                    target = &objects;
 
                     break;
-                }
-
-            case 'p':                   // p or pp polygon primitives
-                {
-                    bool pptype = line[1]=='p';    // 'pp' if next char is 'p'
-
-                    // number of vertices, starting after "p " or "pp"
-                    int nv;
-                    if (sscanf(line+2, "%d", &nv) != 1 || nv < 3) 
-                        err(lineNumber);
-
-                    // polygon primitive w/ type
-                    Polygon *poly = new Polygon(nv, app, pptype);
-
-                    // read vertices
-                    for(int i=0; i<nv; ++i) {
-                        Vec3 v, n;
-                        readLine(f, line, lineNumber);
-                        if (sscanf(line,"%f %f %f %f %f %f", 
-                                    &v[0], &v[1], &v[2],
-                                    &n[0], &n[1], &n[2]) < 3)
-                            err(lineNumber);
-                        poly->addVertex(v, n);
-                    }
-
-                    poly->closePolygon();
 
-                    if (World::effects & World::POLYGONS)
-                        objects.addObject(poly);
-                    else
-                        delete poly;
+                case 'i':               // instance of object group
+                    {
+                        // name followed by a translation "tx ty tz"
+                        // or object to world matrix rows "m00 m01 m02 m03 ..."
+                        std::string name(rec.name, rec.nameLength);
+                        if (target != &objects || ! groups.count(name))
+                            err(rec.line);
+
+                        Xform toWorld;
+                        if (rec.count == 3) {
+                            for(int i=0; i<3; ++i)
+                                toWorld(i,3) = num[i];
+                        }
+                        else if (rec.count == 12) {
+                            for(int i=0; i<3; ++i)
+                                for(int j=0; j<4; ++j)
+                                    toWorld(i,j) = num[4*i + j];
+                        }
+                        else
+                            err(rec.line);
+
+                        if (toWorld.determinant() == 0)
+                            err(rec.line);
+
+                        objects.add<Instance>(groups[name], toWorld);
+
+                        break;
+                    }
 
-                    break;
-                }
-            default:
-                err(lineNumber);
+                default:                // syntax error found by the parser
+                    err(rec.line);
+            }
         }
     }
 
+    if (target != &objects)             // group missing its end
+        err(file.lines() + 1);
+
     // rescale existing lights according to NFF expectation
     float lscale = 1/sqrtf(float(lights.size()));
     for(LightList::iterator li=lights.begin(); li!=lights.end(); ++li)
         li->col = li->col*lscale;
+
+    // all objects are loaded: build acceleration structure
+    objects.build();
+}
+
+// delete object groups; the arena frees the objects in them
+// instances in objects refer to them, but don't use them once deleted
+World::~World()
+{
+    for(GroupMap::iterator gi=groups.begin(); gi!=groups.end(); ++gi)
+        delete gi->second;
 }
@@ -4,8 +4,13 @@
 
 // other classes we use DIRECTLY in our interface
 #include "Vec3.hpp"
+#include "Arena.hpp"
 #include "ObjectList.hpp"
-#include <list>
+#include "VertexPool.hpp"
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
 #include <stdio.h>
 
 struct Light {
@@ -13,7 +18,16 @@ struct Light {
     Vec3 col;                   // light color
     Light() : pos(Vec3(0,0,0)), col(Vec3(1,1,1)) {}
 };
-typedef std::list<Light> LightList;
+typedef std::vector<Light> LightList;
+
+// named groups of objects shared by instances
+typedef std::map<std::string, ObjectList*> GroupMap;
+
+// a scene file that can't be loaded, with the reason as what()
+class SceneError : public std::runtime_error {
+public:
+    explicit SceneError(const std::string &why) : std::runtime_error(why) {}
+};
 
 class World {
 public: // public data
@@ -45,15 +59,31 @@ public: // public data
     float dist, left, right, bottom, top;
 
 
+    // memory for every object and polygon vertex, here and in groups,
+    // freed all at once after the lists that use them
+    Arena arena;
+    VertexPool vertices;
+
     // list of objects in the scene
     ObjectList objects;
 
+    // object groups placed in the scene by instances in objects
+    GroupMap groups;
+
     // list of lights
     LightList lights;
 
 public:                                                     
-    // read world data from a file
-    World(FILE *f);
+    // read world data from a NFF or compiled scene file, parsing
+    // NFF on threads threads (0 for one per core). Throws SceneError
+    // if the file is bad
+    World(FILE *f, int threads = 0);
+
+    // delete object groups
+    ~World();
+
+private:
+    void readNff(FILE *f, int threads);
 };
 
 #endif
@@ -0,0 +1,78 @@
+// affine transforms
+#ifndef XFORM_HPP
+#define XFORM_HPP
+
+// other classes we use DIRECTLY in our interface
+#include "Vec3.hpp"
+
+// 3x4 affine transform: 3x3 linear part in the first three columns
+// and translation in the last, acting on points as m * (x,y,z,1)
+class Xform {
+private: // private data
+    float m[3][4];                  // rows of the matrix
+
+public: // constructors
+    // identity transform
+    Xform() {
+        for(int i=0; i<3; ++i)
+            for(int j=0; j<4; ++j)
+                m[i][j] = (i==j);
+    }
+    // also can use default copy constructor
+
+public:
+    // access as xform(row, column)
+    float operator()(int i, int j) const { return m[i][j]; }
+    float &operator()(int i, int j) { return m[i][j]; }
+
+public: // computational members
+    // transform point, including translation
+    const Vec3 point(const Vec3 &p) const {
+        return Vec3(m[0][0]*p[0] + m[0][1]*p[1] + m[0][2]*p[2] + m[0][3],
+                    m[1][0]*p[0] + m[1][1]*p[1] + m[1][2]*p[2] + m[1][3],
+                    m[2][0]*p[0] + m[2][1]*p[1] + m[2][2]*p[2] + m[2][3]);
+    }
+
+    // transform direction vector, without translation
+    const Vec3 vector(const Vec3 &v) const {
+        return Vec3(m[0][0]*v[0] + m[0][1]*v[1] + m[0][2]*v[2],
+                    m[1][0]*v[0] + m[1][1]*v[1] + m[1][2]*v[2],
+                    m[2][0]*v[0] + m[2][1]*v[1] + m[2][2]*v[2]);
+    }
+
+    // transform by the transpose of the linear part
+    // normals transform this way by the inverse of the point transform
+    const Vec3 transposeVector(const Vec3 &v) const {
+        return Vec3(m[0][0]*v[0] + m[1][0]*v[1] + m[2][0]*v[2],
+                    m[0][1]*v[0] + m[1][1]*v[1] + m[2][1]*v[2],
+                    m[0][2]*v[0] + m[1][2]*v[1] + m[2][2]*v[2]);
+    }
+
+    // determinant of the linear part, 0 if the transform can't be inverted
+    float determinant() const {
+        return m[0][0]*(m[1][1]*m[2][2] - m[1][2]*m[2][1])
+             - m[0][1]*(m[1][0]*m[2][2] - m[1][2]*m[2][0])
+             + m[0][2]*(m[1][0]*m[2][1] - m[1][1]*m[2][0]);
+    }
+
+    // inverse transform, assuming determinant() != 0
+    const Xform inverse() const {
+        Xform r;
+        float s = 1/determinant();
+        // linear part: transposed cofactors over the determinant
+        for(int i=0; i<3; ++i) {
+            int i1 = (i+1)%3, i2 = (i+2)%3;
+            for(int j=0; j<3; ++j) {
+                int j1 = (j+1)%3, j2 = (j+2)%3;
+                r.m[j][i] = s*(m[i1][j1]*m[i2][j2] - m[i1][j2]*m[i2][j1]);
+            }
+        }
+        // translation: -inverse(linear) * translation
+        Vec3 t = r.vector(Vec3(m[0][3], m[1][3], m[2][3]));
+        for(int i=0; i<3; ++i)
+            r.m[i][3] = -t[i];
+        return r;
+    }
+};
+
+#endif
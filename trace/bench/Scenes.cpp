@@ -0,0 +1,364 @@
+// implementation code for Scenes class
+// procedural benchmark scenes, after the Standard Procedural Databases
+
+// include this class include file FIRST to ensure that it has
+// everything it needs for internal self-consistency
+#include "Scenes.hpp"
+
+// other classes used directly in the implementation
+#include "Vec3.hpp"
+
+// system includes
+#include <math.h>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+//////////////////////////////
+// NFF output
+
+// camera at from looking at at, with z up
+static void view(FILE *f, const Vec3 &from, const Vec3 &at, float angle,
+                 int resolution)
+{
+    fprintf(f, "v\nfrom %g %g %g\nat %g %g %g\nup 0 0 1\n"
+               "angle %g\nhither 0.01\nresolution %d %d\n",
+            from[0], from[1], from[2], at[0], at[1], at[2],
+            angle, resolution, resolution);
+}
+
+// background and three white lights around and above center
+static void lights(FILE *f, const Vec3 &center, float distance)
+{
+    fprintf(f, "b 0.078 0.361 0.753\n");
+    static const float dir[3][3] = {{4,3,2}, {1,-4,4}, {-3,1,5}};
+    for(int i=0; i<3; ++i) {
+        Vec3 p = center + normalize(Vec3(dir[i][0], dir[i][1], dir[i][2]))
+            * distance;
+        fprintf(f, "l %g %g %g\n", p[0], p[1], p[2]);
+    }
+}
+
+static void material(FILE *f, const Vec3 &color, float kd, float ks,
+                     float e, float kt = 0, float ir = 1)
+{
+    fprintf(f, "f %g %g %g %g %g %g %g %g\n",
+            color[0], color[1], color[2], kd, ks, e, kt, ir);
+}
+
+static void sphere(FILE *f, const Vec3 &c, float r)
+{
+    fprintf(f, "s %g %g %g %g\n", c[0], c[1], c[2], r);
+}
+
+static void cone(FILE *f, const Vec3 &base, float rBase,
+                 const Vec3 &apex, float rApex)
+{
+    fprintf(f, "c %g %g %g %g %g %g %g %g\n", base[0], base[1], base[2],
+            rBase, apex[0], apex[1], apex[2], rApex);
+}
+
+static void polygon(FILE *f, const std::vector<Vec3> &v)
+{
+    fprintf(f, "p %d\n", int(v.size()));
+    for(size_t i=0; i != v.size(); ++i)
+        fprintf(f, "%g %g %g\n", v[i][0], v[i][1], v[i][2]);
+}
+
+// square of given half width at height z
+static void ground(FILE *f, const Vec3 &center, float half, float z)
+{
+    material(f, Vec3(1, 0.75f, 0.33f), 0.8f, 0, 0);
+    std::vector<Vec3> v;
+    v.push_back(Vec3(center[0] + half, center[1] + half, z));
+    v.push_back(Vec3(center[0] - half, center[1] + half, z));
+    v.push_back(Vec3(center[0] - half, center[1] - half, z));
+    v.push_back(Vec3(center[0] + half, center[1] - half, z));
+    polygon(f, v);
+}
+
+//////////////////////////////
+// helpers
+
+// two unit vectors perpendicular to unit vector d and each other
+static void basis(const Vec3 &d, Vec3 &u, Vec3 &v)
+{
+    Vec3 other = fabsf(d[0]) < 0.6f ? Vec3(1,0,0) : Vec3(0,1,0);
+    u = normalize(other ^ d);
+    v = d ^ u;
+}
+
+// small fixed pseudo-random sequence, the same on every machine
+static unsigned s_seed = 1;
+static float random01()
+{
+    s_seed = s_seed * 1664525u + 1013904223u;
+    return (s_seed >> 8) * (1.f / 16777216);
+}
+
+//////////////////////////////
+// balls
+
+// sphere at c, and its children away from the parent in direction dir
+static void flake(FILE *f, const Vec3 &c, float r, const Vec3 &dir, int depth)
+{
+    sphere(f, c, r);
+    if (depth == 0) return;
+
+    // six children around the equator, three above it toward dir
+    Vec3 u, v;
+    basis(dir, u, v);
+    float cr = r / 3;
+    for(int k=0; k<9; ++k) {
+        float a = k < 6 ? k * float(M_PI)/3 : (4*(k-6) + 1) * float(M_PI)/6;
+        float el = k < 6 ? 0 : float(M_PI)/3;
+        Vec3 d = cosf(el) * (cosf(a)*u + sinf(a)*v) + sinf(el) * dir;
+        flake(f, c + d*(r + cr), cr, d, depth-1);
+    }
+}
+
+static void balls(int size, int resolution, FILE *f)
+{
+    view(f, Vec3(2.1f, 1.3f, 1.7f), Vec3(0, 0, 0.1f), 45, resolution);
+    lights(f, Vec3(0,0,0), 5.4f);
+    ground(f, Vec3(0,0,0), 12, -0.5f);
+    material(f, Vec3(1, 0.9f, 0.7f), 0.5f, 0.5f, 3.0827f);
+    flake(f, Vec3(0,0,0), 0.5f, Vec3(0,0,1), size);
+}
+
+//////////////////////////////
+// gears
+
+// gear of given radius centered at c, teeth turned by phase,
+// as top and bottom faces and sides
+static void gear(FILE *f, const Vec3 &c, float radius, float height,
+                 int teeth, float phase)
+{
+    // each tooth: inner, outer, outer, inner, as fractions of its period
+    static const float at[4] = { 0, 0.15f, 0.35f, 0.5f };
+    float inner = 0.85f * radius;
+    std::vector<Vec3> top, bottom;
+    for(int t=0; t<teeth; ++t)
+        for(int k=0; k<4; ++k) {
+            float a = 2*float(M_PI) * (t + at[k]) / teeth + phase;
+            float r = k == 0 || k == 3 ? inner : radius;
+            top.push_back(c + Vec3(r*cosf(a), r*sinf(a), height));
+        }
+    for(size_t i=top.size(); i != 0; --i)
+        bottom.push_back(top[i-1] - Vec3(0, 0, height));
+    polygon(f, top);
+    polygon(f, bottom);
+
+    for(size_t i=0; i != top.size(); ++i) {
+        const Vec3 &a = top[i], &b = top[(i+1) % top.size()];
+        std::vector<Vec3> side;
+        side.push_back(b);
+        side.push_back(a);
+        side.push_back(a - Vec3(0, 0, height));
+        side.push_back(b - Vec3(0, 0, height));
+        polygon(f, side);
+    }
+}
+
+static void gears(int size, int resolution, FILE *f)
+{
+    int n = 1 << size;              // gears along each side
+    const int TEETH = 16;
+    float spacing = 2.05f;
+    float across = n * spacing;
+    Vec3 center(across/2, across/2, 0);
+    view(f, center + Vec3(-0.5f, -1.f, 0.8f) * across, center, 45, resolution);
+    lights(f, center, 2*across);
+    ground(f, center, 2*across, -0.01f);
+
+    for(int y=0; y<n; ++y)
+        for(int x=0; x<n; ++x) {
+            // neighbors turn half a tooth apart so their teeth mesh
+            if ((x + y) % 3 == 0)
+                material(f, Vec3(0.9f, 0.9f, 1), 0.1f, 0.4f, 40, 0.6f, 1.5f);
+            else
+                material(f, Vec3(0.6f + 0.3f*((x+y) % 2), 0.5f, 0.3f),
+                         0.6f, 0.4f, 20);
+            float phase = (x + y) % 2 ? float(M_PI) / TEETH : 0;
+            gear(f, Vec3((x + 0.5f) * spacing, (y + 0.5f) * spacing, 0),
+                 1, 0.3f, TEETH, phase);
+        }
+}
+
+//////////////////////////////
+// tetra
+
+// four faces of a tetrahedron, or four half-size ones at its corners
+static void tetrahedron(FILE *f, const Vec3 p[4], int depth)
+{
+    if (depth == 0) {
+        Vec3 center = (p[0] + p[1] + p[2] + p[3]) / 4;
+        for(int i=0; i<4; ++i) {
+            std::vector<Vec3> v;
+            for(int k=0; k<4; ++k)
+                if (k != i) v.push_back(p[k]);
+            // wind faces to face outward
+            if (dot((v[1] - v[0]) ^ (v[2] - v[1]), v[0] - center) < 0)
+                std::swap(v[1], v[2]);
+            polygon(f, v);
+        }
+        return;
+    }
+
+    for(int i=0; i<4; ++i) {
+        Vec3 q[4];
+        for(int k=0; k<4; ++k)
+            q[k] = (p[i] + p[k]) / 2;
+        tetrahedron(f, q, depth-1);
+    }
+}
+
+static void tetra(int size, int resolution, FILE *f)
+{
+    view(f, Vec3(1.6f, -2.6f, 1.4f), Vec3(0, 0, 0.4f), 45, resolution);
+    lights(f, Vec3(0,0,0), 6);
+    ground(f, Vec3(0,0,0), 12, 0);
+    material(f, Vec3(1, 0.2f, 0.2f), 0.7f, 0.3f, 30);
+    float s = sqrtf(8.f/9), h = 4.f/3;
+    Vec3 p[4] = {
+        Vec3(s, 0, 0),
+        Vec3(-s/2, s*sqrtf(3.f)/2, 0),
+        Vec3(-s/2, -s*sqrtf(3.f)/2, 0),
+        Vec3(0, 0, h)
+    };
+    tetrahedron(f, p, size + 2);
+}
+
+//////////////////////////////
+// rings
+
+// ring of cylinders around c in the plane perpendicular to n,
+// with spheres at the joints
+static void ring(FILE *f, const Vec3 &c, const Vec3 &n, float radius,
+                 float thickness, int segments)
+{
+    Vec3 u, v;
+    basis(n, u, v);
+    std::vector<Vec3> p;
+    for(int k=0; k<segments; ++k) {
+        float a = 2*float(M_PI) * k / segments;
+        p.push_back(c + radius * (cosf(a)*u + sinf(a)*v));
+    }
+    for(int k=0; k<segments; ++k) {
+        sphere(f, p[k], thickness);
+        cone(f, p[k], thickness, p[(k+1) % segments], thickness);
+    }
+}
+
+static void rings(int size, int resolution, FILE *f)
+{
+    int layers = 2 * size;          // square layers, smaller going up
+    float spacing = 1.2f;
+    Vec3 center(0, 0, layers * spacing / 3);
+    float extent = layers * spacing;
+    view(f, center + Vec3(-0.9f, -1.6f, 1.f) * extent, center, 45, resolution);
+    lights(f, center, 2*extent);
+    ground(f, Vec3(0,0,0), 3*extent, -0.6f);
+
+    static const float colors[5][3] = {
+        {1, 0.4f, 0.3f}, {0.3f, 0.8f, 0.4f}, {0.3f, 0.5f, 1},
+        {1, 0.9f, 0.3f}, {0.8f, 0.4f, 1}
+    };
+    s_seed = 1;
+    int count = 0;
+    for(int l=0; l<layers; ++l) {
+        int n = layers - l;
+        for(int y=0; y<n; ++y)
+            for(int x=0; x<n; ++x) {
+                const float *col = colors[count++ % 5];
+                material(f, Vec3(col[0], col[1], col[2]), 0.6f, 0.4f, 30);
+                Vec3 c((x - (n-1)/2.f) * spacing, (y - (n-1)/2.f) * spacing,
+                       l * spacing * 0.8f);
+                Vec3 normal = normalize(Vec3(random01() - 0.5f,
+                                             random01() - 0.5f, 1));
+                ring(f, c, normal, 0.5f, 0.06f, 24);
+            }
+    }
+}
+
+//////////////////////////////
+// tree
+
+// branch from base along unit dir, then three smaller ones from its end,
+// or a leaf at the end of the last ones
+static void branch(FILE *f, const Vec3 &base, const Vec3 &dir, float length,
+                   float radius, int depth, std::vector<Vec3> &leaves)
+{
+    Vec3 tip = base + dir * length;
+    cone(f, base, radius, tip, radius * 0.7f);
+    if (depth == 0) {
+        leaves.push_back(tip);
+        return;
+    }
+
+    Vec3 u, v;
+    basis(dir, u, v);
+    float spread = 35 * float(M_PI) / 180;
+    for(int k=0; k<3; ++k) {
+        float a = 2*float(M_PI) * k / 3 + 0.7f * depth;
+        Vec3 d = normalize(cosf(spread) * dir +
+                           sinf(spread) * (cosf(a)*u + sinf(a)*v));
+        branch(f, tip, d, length * 0.75f, radius * 0.7f, depth-1, leaves);
+    }
+}
+
+static void tree(int size, int resolution, FILE *f)
+{
+    view(f, Vec3(3.5f, -4.5f, 2.5f), Vec3(0, 0, 1.8f), 45, resolution);
+    lights(f, Vec3(0, 0, 1.5f), 8);
+    ground(f, Vec3(0,0,0), 20, 0);
+
+    // all the branches, then all the leaves in their own material
+    std::vector<Vec3> leaves;
+    material(f, Vec3(0.55f, 0.35f, 0.2f), 0.9f, 0, 0);
+    branch(f, Vec3(0,0,0), Vec3(0,0,1), 1, 0.12f, size + 3, leaves);
+    material(f, Vec3(0.2f, 0.7f, 0.2f), 0.7f, 0.2f, 10);
+    float leaf = 0.75f * powf(0.75f, float(size + 3));
+    for(size_t i=0; i != leaves.size(); ++i)
+        sphere(f, leaves[i], leaf);
+}
+
+//////////////////////////////
+// Scenes
+
+static const struct {
+    const char *name;
+    void (*write)(int size, int resolution, FILE *f);
+} s_scenes[] = {
+    { "balls", balls },
+    { "gears", gears },
+    { "tetra", tetra },
+    { "rings", rings },
+    { "tree", tree }
+};
+
+int
+Scenes::count()
+{
+    return int(sizeof(s_scenes) / sizeof(s_scenes[0]));
+}
+
+const char *
+Scenes::name(int i)
+{
+    return s_scenes[i].name;
+}
+
+int
+Scenes::find(const char *name)
+{
+    for(int i=0; i<count(); ++i)
+        if (strcmp(name, s_scenes[i].name) == 0) return i;
+    return -1;
+}
+
+void
+Scenes::write(int i, int size, int resolution, FILE *f)
+{
+    s_scenes[i].write(size, resolution, f);
+}
@@ -0,0 +1,28 @@
+// procedural benchmark scenes, after the Standard Procedural Databases
+#ifndef SCENES_HPP
+#define SCENES_HPP
+
+// system includes necessary for the interface
+#include <stdio.h>
+
+// Each scene is written as NFF, with the same objects every time for a
+// given size. Size 1 is the smallest; objects grow about 4-9x per step.
+//   balls  sphereflake: spheres with nine children a third their size
+//   gears  grid of toothed gears: large nonconvex polygons, some glass
+//   tetra  Sierpinski tetrahedron of triangles
+//   rings  stacks of rings made of cylinders joined by spheres
+//   tree   branching cones with spheres for leaves
+class Scenes {
+public: // scene list
+    static int count();
+    static const char *name(int i);
+
+    // index of scene with given name, or -1 if there's none
+    static int find(const char *name);
+
+public: // output
+    // write scene i at given size for a resolution x resolution image
+    static void write(int i, int size, int resolution, FILE *f);
+};
+
+#endif
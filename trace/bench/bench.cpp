@@ -0,0 +1,394 @@
+// benchmark runner
+// renders the generated scenes with fixed settings, one trace process per
+// frame, and times each primitive's intersection kernel, writing JSON
+
+// other classes used directly in the implementation
+#include "Scenes.hpp"
+#include "Appearance.hpp"
+#include "Cone.hpp"
+#include "Instance.hpp"
+#include "ObjectList.hpp"
+#include "Polygon.hpp"
+#include "Simd.hpp"
+#include "Sphere.hpp"
+#include "Triangle.hpp"
+#include "Xform.hpp"
+
+// system includes
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// process control, so this runner is POSIX only
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef TRACE_PROGRAM
+#define TRACE_PROGRAM "trace"
+#endif
+
+// shortest time to spend on each kernel
+static const double KERNEL_SECONDS = 0.2;
+
+// rays per kernel pass
+static const int KERNEL_RAYS = 4096;
+
+// what one trace run reported
+struct Run {
+    int objects;
+    int threads;
+    double buildMs;             // acceleration structure build
+    double renderMs;            // all strips, including writing the image
+    double totalMs;             // whole process, including loading
+    long rays;                  // primary rays
+    long peakKb;                // peak resident set size
+    char accel[32], simd[32];
+};
+
+// run trace on file with given threads, filling in run
+// returns false if it didn't run or didn't report a render
+static bool runTrace(const char *program, const char *file, int threads,
+                     Run &run)
+{
+    int out[2];
+    if (pipe(out) != 0) return false;
+
+    char threadArg[16];
+    snprintf(threadArg, sizeof(threadArg), "%d", threads);
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        dup2(out[1], 1);
+        close(out[0]);
+        close(out[1]);
+        execl(program, program, "-threads", threadArg, "-o", "/dev/null",
+              file, (char*)0);
+        _exit(127);
+    }
+    close(out[1]);
+
+    // read everything it prints, then its exit status and resource use
+    std::string text;
+    char block[4096];
+    ssize_t n;
+    while((n = read(out[0], block, sizeof(block))) > 0)
+        text.append(block, n);
+    close(out[0]);
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid ||
+        ! WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return false;
+    run.totalMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - t0).count();
+    run.peakKb = usage.ru_maxrss;
+
+    bool rendered = false;
+    size_t start = 0;
+    while(start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) end = text.size();
+        std::string line = text.substr(start, end - start);
+        start = end + 1;
+
+        const char *s = line.c_str();
+        char accel[32];
+        if (sscanf(s, "%31s over %d objects, built in %lf ms",
+                   accel, &run.objects, &run.buildMs) == 3)
+            strcpy(run.accel, accel);
+        sscanf(s, "simd kernels: %31s", run.simd);
+        sscanf(s, "rendering on %d threads", &run.threads);
+        if (sscanf(s, "rendered %ld primary rays in %lf ms",
+                   &run.rays, &run.renderMs) == 2)
+            rendered = true;
+    }
+    return rendered;
+}
+
+// middle value
+static double median(std::vector<double> v)
+{
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 ? v[n/2] : (v[n/2 - 1] + v[n/2]) / 2;
+}
+
+//////////////////////////////
+// kernels
+
+// float in [0,1) from a fixed sequence
+static float random01()
+{
+    static unsigned seed = 7;
+    seed = seed * 1664525u + 1013904223u;
+    return (seed >> 8) * (1.f / 16777216);
+}
+
+// rays from a sphere of radius 4 toward points near the origin,
+// so some hit and some miss objects about 1 in size
+static std::vector<Ray> kernelRays()
+{
+    std::vector<Ray> rays;
+    for(int i=0; i<KERNEL_RAYS; ++i) {
+        Vec3 from(random01() - 0.5f, random01() - 0.5f, random01() - 0.5f);
+        from = normalize(from) * 4;
+        Vec3 to(2.4f*random01() - 1.2f, 2.4f*random01() - 1.2f,
+                2.4f*random01() - 1.2f);
+        rays.push_back(Ray(from, to - from));
+    }
+    return rays;
+}
+
+// time calls of test(ray) over rays, which returns whether it hit,
+// and report ns per call as JSON
+template <class Test>
+static void timeKernel(FILE *out, const char *name, int lanes,
+                       const std::vector<Ray> &rays, Test test, bool last)
+{
+    long hits = 0, calls = 0;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    double seconds = 0;
+    do {
+        for(size_t i=0; i != rays.size(); ++i)
+            hits += test(rays[i]);
+        calls += long(rays.size());
+        seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - t0).count();
+    } while(seconds < KERNEL_SECONDS);
+
+    fprintf(out, "    {\"primitive\": \"%s\", \"lanes\": %d, "
+            "\"ns_per_call\": %.2f, \"hit_fraction\": %.3f}%s\n",
+            name, lanes, seconds * 1e9 / calls,
+            double(hits) / (calls * lanes), last ? "" : ",");
+}
+
+// each object type's intersect(), called through Object like the
+// acceleration structures do, and the SIMD block kernels
+static void kernels(FILE *out)
+{
+    std::vector<Ray> rays = kernelRays();
+    Appearance app;
+
+    Sphere sphere(app, Vec3(0,0,0), 1);
+    Cone cone(app, Vec3(0,0,-1), 0.8f, Vec3(0,0,1), 0.3f);
+    Triangle triangle(app, Vec3(-1,-1,0), Vec3(1,-1,0), Vec3(0,1,0.2f),
+                      Vec3(0,0,1));
+
+    // nonconvex star, since convex polygons become triangles
+    VertexPool vertices;
+    Polygon polygon(vertices, app, false);
+    for(int k=0; k<10; ++k) {
+        float a = 2*float(M_PI) * k / 10, r = k % 2 ? 0.45f : 1.1f;
+        polygon.addVertex(Vec3(r*cosf(a), r*sinf(a), 0), Vec3(0,0,1));
+    }
+    polygon.closePolygon();
+
+    // group of one sphere, placed rotated and scaled
+    ObjectList group;
+    group.add<Sphere>(app, Vec3(0,0,0), 1);
+    group.build();
+    Xform place;
+    place(0,0) = 0.8f;  place(0,1) = -0.6f;
+    place(1,0) = 0.6f;  place(1,1) = 0.8f;
+    place(2,2) = 0.9f;  place(0,3) = 0.1f;
+    Instance instance(&group, place);
+
+    const Object *objects[] = { &sphere, &cone, &triangle, &polygon, &instance };
+    const char *names[] = { "sphere", "cone", "triangle", "polygon", "instance" };
+    for(int i=0; i<5; ++i) {
+        const Object *obj = objects[i];
+        timeKernel(out, names[i], 1, rays, [obj](const Ray &r) {
+            return obj->intersect(r).t < INFINITY;
+        }, false);
+    }
+
+    // eight slightly different spheres, cones or triangles per call
+    SphereBlock spheres;
+    ConeBlock cones;
+    TriangleBlock triangles;
+    for(int k=0; k<SphereBlock::SIZE; ++k) {
+        float s = 1 + 0.01f*k;
+        SphereGeometry sg = sphere.geometry();
+        sg.radius *= s;
+        spheres.set(k, sg);
+        cones.set(k, Cone(app, Vec3(0,0,-s), 0.8f, Vec3(0,0,s), 0.3f).geometry());
+        triangles.set(k, Triangle(app, Vec3(-s,-s,0), Vec3(s,-s,0),
+                                  Vec3(0,s,0.2f), Vec3(0,0,1)).geometry());
+    }
+    timeKernel(out, "sphere_block", SphereBlock::SIZE, rays,
+               [&spheres](const Ray &r) {
+                   float t[SphereBlock::SIZE];
+                   return __builtin_popcount(Simd::spheres(spheres, r, t));
+               }, false);
+    timeKernel(out, "cone_block", ConeBlock::SIZE, rays,
+               [&cones](const Ray &r) {
+                   float t[ConeBlock::SIZE];
+                   return __builtin_popcount(Simd::cones(cones, r, t));
+               }, false);
+    timeKernel(out, "triangle_block", TriangleBlock::SIZE, rays,
+               [&triangles](const Ray &r) {
+                   float t[TriangleBlock::SIZE];
+                   return __builtin_popcount(Simd::triangles(triangles, r, t));
+               }, true);
+}
+
+//////////////////////////////
+
+int main(int argc, char **argv)
+{
+    // defaults for command line arguments
+    int size = 3;               // scene detail
+    int resolution = 256;       // image width and height
+    int frames = 3;             // renders of each scene
+    int threads = 0;            // trace threads, 0 for one per core
+    const char *program = TRACE_PROGRAM;
+    const char *outName = 0;    // JSON output, stdout if none
+    const char *generate = 0;   // only write scenes to this directory
+    bool runScenes = true, runKernels = true;
+    std::vector<int> scenes;
+
+    char *progname = argv[0];
+    ++argv; --argc;
+    while(argc != 0) {
+        if (argc >= 2 && strcmp(argv[0], "-size") == 0)
+            size = atoi(argv[1]);
+        else if (argc >= 2 && strcmp(argv[0], "-res") == 0)
+            resolution = atoi(argv[1]);
+        else if (argc >= 2 && strcmp(argv[0], "-frames") == 0)
+            frames = atoi(argv[1]);
+        else if (argc >= 2 && strcmp(argv[0], "-threads") == 0)
+            threads = atoi(argv[1]);
+        else if (argc >= 2 && strcmp(argv[0], "-trace") == 0)
+            program = argv[1];
+        else if (argc >= 2 && strcmp(argv[0], "-o") == 0)
+            outName = argv[1];
+        else if (argc >= 2 && strcmp(argv[0], "-generate") == 0)
+            generate = argv[1];
+        else if (argc >= 2 && strcmp(argv[0], "-scene") == 0 &&
+                 Scenes::find(argv[1]) >= 0)
+            scenes.push_back(Scenes::find(argv[1]));
+        else if (argc >= 2 && strcmp(argv[0], "-no") == 0 &&
+                 strcmp(argv[1], "scenes") == 0)
+            runScenes = false;
+        else if (argc >= 2 && strcmp(argv[0], "-no") == 0 &&
+                 strcmp(argv[1], "kernels") == 0)
+            runKernels = false;
+        else
+            break;
+        argv += 2; argc -= 2;
+    }
+
+    if (argc > 0 || size < 1 || resolution < 1 || frames < 1) {
+        printf("Usage: %s [options]\n", progname);
+        printf("options:\n"
+                "  -size <n>\n"
+                "    scene detail, 1 and up (default 3)\n"
+                "  -res <n>\n"
+                "    image width and height (default 256)\n"
+                "  -frames <n>\n"
+                "    renders of each scene; the median is reported (default 3)\n"
+                "  -threads <n>\n"
+                "    trace render threads (default: one per core)\n"
+                "  -scene balls, gears, tetra, rings, tree\n"
+                "    scene to render, may be repeated (default: all)\n"
+                "  -trace <program>\n"
+                "    trace program to time (default: the one built with this)\n"
+                "  -o <file>\n"
+                "    write JSON results to file instead of standard output\n"
+                "  -generate <directory>\n"
+                "    only write the scenes as NFF files to directory\n"
+                "  -no scenes, -no kernels\n"
+                "    skip scene renders or primitive kernel timing\n");
+        return 1;
+    }
+    if (scenes.empty())
+        for(int i=0; i<Scenes::count(); ++i)
+            scenes.push_back(i);
+
+    // write scenes where asked, or to a directory removed when done
+    char tmp[] = "/tmp/tracebench.XXXXXX";
+    std::string dir = generate ? generate : "";
+    if (generate)
+        mkdir(generate, 0777);      // may already exist
+    else if (runScenes) {
+        if (! mkdtemp(tmp)) {
+            fprintf(stderr, "can't make scene directory\n");
+            return 1;
+        }
+        dir = tmp;
+    }
+    std::vector<std::string> files;
+    for(size_t i=0; i != scenes.size() && (generate || runScenes); ++i) {
+        std::string file = dir + "/" + Scenes::name(scenes[i]) + ".nff";
+        FILE *f = fopen(file.c_str(), "w");
+        if (! f) {
+            fprintf(stderr, "error opening %s\n", file.c_str());
+            return 1;
+        }
+        Scenes::write(scenes[i], size, resolution, f);
+        fclose(f);
+        files.push_back(file);
+    }
+    if (generate) return 0;
+
+    FILE *out = outName ? fopen(outName, "w") : stdout;
+    if (! out) {
+        fprintf(stderr, "error opening %s\n", outName);
+        return 1;
+    }
+    fprintf(out, "{\n  \"size\": %d,\n  \"resolution\": %d,\n"
+            "  \"frames\": %d,\n  \"scenes\": [\n", size, resolution, frames);
+
+    bool ok = true;
+    for(size_t i=0; i != files.size() && runScenes; ++i) {
+        const char *name = Scenes::name(scenes[i]);
+        fprintf(stderr, "%s...\n", name);
+        std::vector<double> render, total;
+        Run run;
+        memset(&run, 0, sizeof(run));
+        long peakKb = 0;
+        for(int frame=0; frame<frames; ++frame) {
+            if (! runTrace(program, files[i].c_str(), threads, run)) {
+                fprintf(stderr, "%s failed on %s\n", program, files[i].c_str());
+                ok = false;
+                break;
+            }
+            render.push_back(run.renderMs);
+            total.push_back(run.totalMs);
+            peakKb = std::max(peakKb, run.peakKb);
+        }
+        if (render.empty()) continue;
+
+        double ms = median(render);
+        fprintf(out, "    {\"name\": \"%s\", \"objects\": %d, \"accel\": \"%s\", "
+                "\"simd\": \"%s\", \"threads\": %d, \"build_ms\": %.2f, "
+                "\"ms_per_frame\": %.2f, \"total_ms\": %.2f, "
+                "\"primary_rays\": %ld, \"rays_per_second\": %.0f, "
+                "\"peak_rss_kb\": %ld}%s\n",
+                name, run.objects, run.accel, run.simd, run.threads,
+                run.buildMs, ms, median(total), run.rays,
+                ms > 0 ? run.rays / (ms / 1000) : 0., peakKb,
+                i+1 != files.size() ? "," : "");
+    }
+    fprintf(out, "  ],\n  \"kernels\": [\n");
+    if (runKernels) {
+        fprintf(stderr, "kernels...\n");
+        kernels(out);
+    }
+    fprintf(out, "  ]\n}\n");
+    if (out != stdout) fclose(out);
+
+    if (! generate) {
+        for(size_t i=0; i != files.size(); ++i)
+            remove(files[i].c_str());
+        if (! dir.empty()) rmdir(dir.c_str());
+    }
+    return ok ? 0 : 1;
+}
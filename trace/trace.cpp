@@ -2,17 +2,42 @@
 // includes input file parsing and spawning screen pixel rays
 
 // classes used directly by this file
+#include "Appearance.hpp"
+#include "Camera.hpp"
+#include "Checkpoint.hpp"
+#include "CommandServer.hpp"
+#include "HeatMap.hpp"
+#include "ImageWriter.hpp"
+#include "Intersection.hpp"
 #include "ObjectList.hpp"
 #include "Polygon.hpp"
 #include "Sphere.hpp"
 #include "Ray.hpp"
+#include "RayPacket.hpp"
+#include "Sampler.hpp"
+#include "SceneFile.hpp"
 #include "World.hpp"
 #include "Vec3.hpp"
+#include "Wavefront.hpp"
+#include "WorkPool.hpp"
+#include "ShadowCache.hpp"
+#include "Simd.hpp"
+#include "Stats.hpp"
 
 // standard includes
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
 
 #ifdef _WIN32
 // don't complain about MS-deprecated standard C functions
@@ -25,17 +50,20 @@
 #define DOF
 //#define ANTIALIAS
 
-// float in [0,1) distributed according to a Halton sequence with given base
-float halton(int i, int base)
-{
-    int r = 0, scale=1;
-    while(i != 0) {
-        r = r * base + i % base;    // add digit to result
-        i /= base;                  // update current value;
-        scale *= base;              // increase total scale by one digit
-    }
-    return float(r)/float(scale);
-}
+// lines and columns in one tile of work for a render thread
+static const int TILE = 16;
+
+// lines in one band of work in wavefront mode
+static const int WAVE_BAND = 32;
+
+// lines rendered before they are written out, by default
+static const int STRIP = 256;
+
+// samples per pixel between error checks in adaptive sampling
+static const int ADAPTIVE_BATCH = 4;
+
+// most bounces -depth allows
+static const int MAX_DEPTH = 64;
 
 // Box-Mueller transform to convert pair of random numbers on [-.5,.5)
 // to pair of Gaussian-distributed random numbers with standard deviation 0.5
@@ -56,75 +84,954 @@ void disk(float &x, float &y)
     y = radius * sin(theta);
 }
 
+// what a heat map measures
+enum HeatCost { HEAT_TESTS, HEAT_TIME };
+
+// everything about one render but the scene, from the command line or a
+// render command in server mode
+struct RenderOptions {
+    float aperture;             // depth of field aperture
+    int samples;                // depth of field and antialiasing samples
+    float adaptive;             // error target for adaptive sampling, 0 if off
+    int packet;                 // primary rays traced in packet x packet blocks
+    bool wavefront;             // trace breadth first from ray queues
+    int threads;                // render threads, 0 for one per core
+    const char *outName;        // image file, PFM if it ends in .pfm
+    int strip;                  // lines rendered before they are written
+    const char *checkpointName; // sample totals to resume and save
+    const char *heatName;       // render cost image
+    HeatCost heatMeasure;
+    Sampler::Type sampling;
+    unsigned effects;           // World::effects bits
+    int lightSamples;           // for Appearance::lightSamples
+    int depth;                  // for Appearance::depth
+    bool verbose;               // report progress and results on stdout
+
+    // changes to the scene's view: which parts are set, and their values
+    enum { EYE = 1, AT = 2, UP = 4, ANGLE = 8 };
+    unsigned look;
+    Vec3 eye, at, up;
+    float angle;
+    int width, height;          // image size, 0 for the scene's
+
+    RenderOptions()
+        : aperture(0), samples(1), adaptive(0), packet(4), wavefront(false),
+          threads(0), outName("trace.ppm"), strip(STRIP), checkpointName(0),
+          heatName(0), heatMeasure(HEAT_TESTS), sampling(Sampler::HALTON),
+          effects(World::effects &
+                  ~(World::DEPTH_OF_FIELD | World::ANTIALIAS)),
+          lightSamples(Appearance::lightSamples), depth(Appearance::depth),
+          verbose(true), look(0), angle(0), width(0), height(0) {}
+
+    // options that don't mix
+    bool conflicting() const {
+        return wavefront &&
+            (adaptive > 0 || lightSamples > 0 || checkpointName || heatName);
+    }
+
+    // the scene's view with these changes
+    Camera camera(const World &world) const {
+        Camera cam(world);
+        if (width)
+            cam.resize(width, height);
+        if (look)
+            cam.look(look & EYE ? eye : cam.eye, look & AT ? at : cam.at(),
+                     look & UP ? up : cam.v, look & ANGLE ? angle : cam.angle());
+        return cam;
+    }
+};
+
+// shading effects -no and -with turn off and on
+static const struct {
+    const char *name;
+    unsigned bit;
+} EFFECT_NAMES[] = {
+    { "diffuse", World::DIFFUSE },   { "specular", World::SPECULAR },
+    { "shadow", World::SHADOW },     { "reflect", World::REFLECT },
+    { "refract", World::REFRACT },   { "polygons", World::POLYGONS },
+    { "cones", World::CONES },       { "spheres", World::SPHERES }
+};
+
+// effects that pick what is loaded, rather than how it is shaded
+static const unsigned LOAD_EFFECTS =
+    World::POLYGONS | World::CONES | World::SPHERES;
+
+// effects bit named name, or 0
+static unsigned effectBit(const char *name)
+{
+    for(size_t k=0; k != sizeof(EFFECT_NAMES)/sizeof(EFFECT_NAMES[0]); ++k)
+        if (strcmp(name, EFFECT_NAMES[k].name) == 0)
+            return EFFECT_NAMES[k].bit;
+    return 0;
+}
+
+// parse the render option at the start of argv into opt, returning the
+// arguments it used, or 0 if it isn't one or its values are bad
+static int parseRenderOption(int argc, char **argv, RenderOptions &opt)
+{
+    if (argc >= 2 && strcmp(argv[0], "-s") == 0) {
+        sscanf(argv[1], "%d", &opt.samples);
+        return 2;
+    }
+
+    if (argc >= 2 && strcmp(argv[0], "-adaptive") == 0) {
+        sscanf(argv[1], "%f", &opt.adaptive);
+        return 2;
+    }
+
+    if (argc >= 2 && strcmp(argv[0], "-lights") == 0) {
+        sscanf(argv[1], "%d", &opt.lightSamples);
+        return 2;
+    }
+
+    if (argc >= 2 && strcmp(argv[0], "-depth") == 0) {
+        sscanf(argv[1], "%d", &opt.depth);
+        if (opt.depth < 0 || opt.depth > MAX_DEPTH)
+            return 0;
+        return 2;
+    }
+
+    if (argc >= 2 && strcmp(argv[0], "-dof") == 0) {
+        sscanf(argv[1], "%f", &opt.aperture);
+        opt.effects |= World::DEPTH_OF_FIELD;
+        return 2;
+    }
+
+    if (argc >= 2 && strcmp(argv[0], "-sampler") == 0) {
+        if (strcmp(argv[1], "halton") == 0)
+            opt.sampling = Sampler::HALTON;
+        else if (strcmp(argv[1], "sobol") == 0)
+            opt.sampling = Sampler::SOBOL;
+        else
+            return 0;
+        return 2;
+    }
+
+    if (argc >= 2 && strcmp(argv[0], "-packet") == 0) {
+        sscanf(argv[1], "%d", &opt.packet);
+        if (opt.packet < 1 || opt.packet*opt.packet > RayPacket::SIZE)
+            return 0;
+        return 2;
+    }
+
+    if (argc >= 2 && strcmp(argv[0], "-o") == 0) {
+        opt.outName = argv[1];
+        return 2;
+    }
+
+    if (argc >= 2 && strcmp(argv[0], "-checkpoint") == 0) {
+        opt.checkpointName = argv[1];
+        return 2;
+    }
+
+    if (argc >= 2 && strcmp(argv[0], "-strip") == 0) {
+        sscanf(argv[1], "%d", &opt.strip);
+        if (opt.strip < 1)
+            return 0;
+        return 2;
+    }
+
+    if (argc >= 2 && strcmp(argv[0], "-threads") == 0) {
+        sscanf(argv[1], "%d", &opt.threads);
+        return 2;
+    }
+
+    if (strcmp(argv[0], "-wavefront") == 0) {
+        opt.wavefront = true;
+        return 1;
+    }
+
+    if (strcmp(argv[0], "-aa") == 0) {
+        opt.effects |= World::ANTIALIAS;
+        return 1;
+    }
+
+    if (argc >= 2 && strcmp(argv[0], "-no") == 0) {
+        unsigned bit = effectBit(argv[1]);
+        opt.effects &= ~bit;
+        return bit ? 2 : 0;
+    }
+
+    if (argc >= 2 && strcmp(argv[0], "-with") == 0) {
+        unsigned bit = effectBit(argv[1]);
+        opt.effects |= bit;
+        return bit ? 2 : 0;
+    }
+
+    if (argc >= 3 && strcmp(argv[0], "-heatmap") == 0) {
+        if (strcmp(argv[1], "tests") == 0 && Stats::enabled())
+            opt.heatMeasure = HEAT_TESTS;
+        else if (strcmp(argv[1], "time") == 0)
+            opt.heatMeasure = HEAT_TIME;
+        else
+            return 0;
+        opt.heatName = argv[2];
+        return 3;
+    }
+
+    // view changes
+    static const struct { const char *name; unsigned bit; } POINTS[] = {
+        { "-eye", RenderOptions::EYE }, { "-at", RenderOptions::AT },
+        { "-up", RenderOptions::UP }
+    };
+    for(int k=0; k<3; ++k)
+        if (argc >= 4 && strcmp(argv[0], POINTS[k].name) == 0) {
+            Vec3 &p = k == 0 ? opt.eye : k == 1 ? opt.at : opt.up;
+            for(int c=0; c<3; ++c)
+                if (sscanf(argv[1+c], "%f", &p[c]) != 1)
+                    return 0;
+            opt.look |= POINTS[k].bit;
+            return 4;
+        }
+
+    if (argc >= 2 && strcmp(argv[0], "-angle") == 0) {
+        if (sscanf(argv[1], "%f", &opt.angle) != 1 ||
+            opt.angle <= 0 || opt.angle >= 180)
+            return 0;
+        opt.look |= RenderOptions::ANGLE;
+        return 2;
+    }
+
+    if (argc >= 3 && strcmp(argv[0], "-size") == 0) {
+        if (sscanf(argv[1], "%d", &opt.width) != 1 ||
+            sscanf(argv[2], "%d", &opt.height) != 1 ||
+            opt.width < 1 || opt.height < 1)
+            return 0;
+        return 3;
+    }
+
+    return 0;
+}
+
+// primary ray for sample samp of a pixel
+Ray primaryRay(const RenderOptions &opt, const Camera &cam,
+               const Sampler::Pixel &pixel, int samp)
+{
+    int i = pixel.i(), j = pixel.j();
+
+    // new jittered eye position
+    float dofX = 0, dofY = 0;
+    if (opt.effects & World::DEPTH_OF_FIELD) {
+        pixel.get(samp, Sampler::LENS, dofX, dofY);
+        dofX -= 0.5f, dofY -= 0.5f;
+        disk(dofX, dofY);
+        dofX *= opt.aperture; dofY *= opt.aperture;
+    }
+    Vec3 eye = cam.eye + dofX * cam.u + dofY * cam.v;
+
+    // new ray center
+    float aaX = 0, aaY = 0;
+    if (opt.effects & World::ANTIALIAS) {
+        pixel.get(samp, Sampler::FILTER, aaX, aaY);
+        aaX -= 0.5f, aaY -= 0.5f;
+        gaussian(aaX, aaX);
+    }
+    float us = cam.left +
+        (cam.right - cam.left) * (i+aaX+0.5f)/cam.width;
+    float vs = cam.top +
+        (cam.bottom - cam.top) * (j+aaY+0.5f)/cam.height;
+    Vec3 pix = cam.eye - cam.dist * cam.w
+        + us * cam.u + vs * cam.v;
+
+    // new ray allowing up to Appearance::depth bounces, ray contribution=255,
+    // index of refraction=1, don't trace closer than hither plane, and
+    // shading choices seeded by the sample
+    Stats::ray(Stats::PRIMARY, Appearance::depth);
+    return Ray(eye, pix - eye,
+               cam.hither / cam.dist, INFINITY,
+               Appearance::depth, 255, unsigned(samp));
+}
+
+// cost so far on this thread: intersection tests, or microseconds
+static double heatCost(HeatCost measure)
+{
+    if (measure == HEAT_TESTS)
+        return double(Stats::threadTests());
+    return std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// add samples for pixels [i0,i1) x [j0,j1) to their totals in strip,
+// which holds lines from top down, tracing primary rays a block of
+// pixels at a time, one packet for each sample. Pixels continue from
+// samples they already have, until they reach samples or, if adaptive is
+// nonzero, until their error is below adaptive after a batch of samples.
+// If heat is not 0, it holds lines like strip, and each sample's rays
+// are traced one at a time to add the cost of each to its pixel.
+// Returns the number of samples
+long renderTile(const World &world, const Camera &cam,
+                const RenderOptions &opt, const Sampler &sampler,
+                int i0, int j0, int i1, int j1,
+                PixelSum strip[], int top, float heat[])
+{
+    int samples = opt.samples, packet = opt.packet;
+    float adaptive = opt.adaptive;
+    long traced = 0;
+    std::vector<Ray> rays;
+    rays.reserve(RayPacket::SIZE);
+    Intersection hits[RayPacket::SIZE];
+    int batch = adaptive > 0 && ADAPTIVE_BATCH < samples ? ADAPTIVE_BATCH : samples;
+    for(int bj=j0; bj<j1; bj += packet) {
+        int nj = j1 - bj < packet ? j1 - bj : packet;
+        for(int bi=i0; bi<i1; bi += packet) {
+            int ni = i1 - bi < packet ? i1 - bi : packet;
+
+            // pixels in the block still taking samples
+            PixelSum *acc[RayPacket::SIZE];
+            Sampler::Pixel pixel[RayPacket::SIZE];
+            int active[RayPacket::SIZE], count = 0;
+            for(int k=0; k<ni*nj; ++k) {
+                int i = bi + k%ni, j = bj + k/ni;
+                acc[k] = &strip[(j-top)*cam.width + i];
+                pixel[k] = sampler.pixel(i, j);
+                if (acc[k]->n < samples &&
+                    ! (adaptive > 0 && acc[k]->error() <= adaptive))
+                    active[count++] = k;
+            }
+
+            // depth of field and antialiasing samples, each pixel taking
+            // its next one. Sample samp of a pixel is the same ray however
+            // many are taken
+            while(count) {
+                for(int b=0; b < batch && count; ++b) {
+                    rays.clear();
+                    for(int a=0; a<count; ++a)
+                        rays.push_back(primaryRay(opt, cam, pixel[active[a]],
+                                                  acc[active[a]]->n));
+
+                    if (! heat)
+                        world.objects.trace(RayPacket(&rays[0], count), hits);
+                    int kept = 0;
+                    for(int a=0; a<count; ++a) {
+                        if (heat) {
+                            const Sampler::Pixel &p = pixel[active[a]];
+                            double before = heatCost(opt.heatMeasure);
+                            hits[a] = world.objects.trace(rays[a]);
+                            acc[active[a]]->add(hits[a].color(world, rays[a]));
+                            heat[(p.j()-top)*cam.width + p.i()] +=
+                                float(heatCost(opt.heatMeasure) - before);
+                        }
+                        else
+                            acc[active[a]]->add(hits[a].color(world, rays[a]));
+                        if (acc[active[a]]->n < samples)
+                            active[kept++] = active[a];
+                    }
+                    traced += count;
+                    count = kept;
+                }
+
+                // keep pixels whose error is still too large
+                if (adaptive > 0) {
+                    int kept = 0;
+                    for(int a=0; a<count; ++a)
+                        if (acc[active[a]]->error() > adaptive)
+                            active[kept++] = active[a];
+                    count = kept;
+                }
+            }
+        }
+    }
+    return traced;
+}
+
+// queue all samples for lines [j0,j1), then trace them breadth first,
+// adding color summed over samples into strip, which holds lines from top
+void renderBand(const World &world, const Camera &cam,
+                const RenderOptions &opt, const Sampler &sampler,
+                int j0, int j1, Vec3 strip[], int top)
+{
+    Wavefront wave(world, cam.eye);
+    for(int j=j0; j<j1; ++j)
+        for(int i=0; i<cam.width; ++i) {
+            Sampler::Pixel pixel = sampler.pixel(i, j);
+            for(int samp = 0; samp < opt.samples; ++samp)
+                wave.add(primaryRay(opt, cam, pixel, samp),
+                         (j-top)*cam.width + i, 1);
+        }
+    wave.run(strip);
+}
+
+// prints "line j" for every 32nd line of lines [top,bottom), in order,
+// as bands of lines finish on any thread
+class Progress {
+private:
+    std::mutex d_lock;
+    std::vector<int> d_left;        // tiles left in each band
+    int d_next;                     // first band not yet reported
+    int d_top, d_bottom, d_band;    // lines to report, and lines in a band
+
+public:
+    Progress(int top, int bottom, int band, int tiles)
+        : d_left((bottom-top + band-1) / band, tiles), d_next(0),
+          d_top(top), d_bottom(bottom), d_band(band) {}
+
+    // one tile of band b is done
+    void done(int b) {
+        std::lock_guard<std::mutex> hold(d_lock);
+        --d_left[b];
+        for(; d_next < int(d_left.size()) && d_left[d_next] == 0; ++d_next)
+            for(int j = d_top + d_next*d_band;
+                j < d_top + (d_next+1)*d_band && j < d_bottom; ++j)
+                if (j % 32 == 0) printf("line %d\n",j); // show current line
+    }
+};
+
+
+// render world as opt asks, writing its image, and its checkpoint and
+// heat map if it has them. Sets rays to the primary rays traced and
+// seconds to the time the render took. Returns false, having said why on
+// stderr, if a file can't be read or written
+static bool render(const World &world, const RenderOptions &opt,
+                   long &rays, double &seconds)
+{
+    Camera cam = opt.camera(world);
+
+    // image file, written a strip at a time as strips finish
+    FILE *output = fopen(opt.outName, "wb");
+    if (!output) {
+        fprintf(stderr, "error opening %s\n", opt.outName);
+        return false;
+    }
+    ImageWriter writer(output, ImageWriter::formatOf(opt.outName),
+                       cam.width, cam.height);
+
+    // split each strip into bands of lines, and those into tiles,
+    // each rendered on whichever thread gets to it
+    WorkPool pool(opt.threads);
+    if (opt.verbose)
+        printf("rendering on %d threads\n", pool.threads());
+    int band = opt.wavefront ? WAVE_BAND : TILE;
+    int stripLines = (opt.strip + band-1) / band * band;
+    int strips = (cam.height + stripLines-1) / stripLines;
+    int across = opt.wavefront ? 1 : (cam.width + TILE-1) / TILE;
+    std::vector<Vec3> colors;       // lines of the strip being rendered
+    std::vector<PixelSum> sums;     // their sample totals, without wavefront
+    std::atomic<long> traced(0);    // primary samples, without wavefront
+    HeatMap heatmap(opt.heatName ? cam.width : 0,
+                    opt.heatName ? cam.height : 0);
+
+    // sample totals saved by earlier runs, which also fix the pattern
+    // of samples so more can be added to them
+    Checkpoint checkpoint;
+    int stride = opt.samples;       // samples in one round of the pattern
+    if (opt.checkpointName) {
+        Checkpoint::Pattern pattern;
+        pattern.sampling = opt.sampling;
+        pattern.effects = opt.effects &
+            (World::DEPTH_OF_FIELD | World::ANTIALIAS);
+        pattern.aperture = opt.effects & World::DEPTH_OF_FIELD ? opt.aperture
+                                                               : 0;
+        if (! checkpoint.open(opt.checkpointName, cam.width, cam.height,
+                              opt.samples, pattern)) {
+            fprintf(stderr, "error opening checkpoint %s, or it is for "
+                    "another image size, sampler, -aa or -dof\n",
+                    opt.checkpointName);
+            writer.finish();
+            fclose(output);
+            return false;
+        }
+        stride = checkpoint.stride();
+        if (opt.verbose)
+            printf("%s checkpoint %s\n", checkpoint.resumed() ? "continuing"
+                                                              : "starting",
+                   opt.checkpointName);
+    }
+
+    Sampler sampler(opt.sampling, cam.width, cam.height, stride);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int s=0; s<strips; ++s) {
+        int top = (writer.bottomUp() ? strips-1 - s : s) * stripLines;
+        int bottom = top + stripLines < cam.height ? top + stripLines
+                                                   : cam.height;
+        int bands = (bottom - top + band-1) / band;
+        colors.assign(size_t(bottom - top) * cam.width, Vec3());
+        if (! opt.wavefront) sums.assign(colors.size(), PixelSum());
+        if (opt.checkpointName) checkpoint.load(top, bottom, &sums[0]);
+        Progress progress(top, bottom, band, across);
+
+        {
+            Stats::Timer render(Stats::RENDER);
+            pool.run(bands*across, [&](int item) {
+                int j0 = top + item / across * band, i0 = item % across * TILE;
+                int j1 = j0 + band < bottom ? j0 + band : bottom;
+                if (opt.wavefront)
+                    renderBand(world, cam, opt, sampler, j0, j1,
+                               &colors[0], top);
+                else {
+                    int i1 = i0 + TILE < cam.width ? i0 + TILE : cam.width;
+                    traced += renderTile(world, cam, opt, sampler,
+                                         i0, j0, i1, j1, &sums[0], top,
+                                         opt.heatName ? heatmap.line(top) : 0);
+                }
+                if (opt.verbose) progress.done(item / across);
+            });
+        }
+
+        if (opt.checkpointName) {
+            Stats::Timer write(Stats::WRITE);
+            if (! checkpoint.save(top, bottom, &sums[0])) {
+                fprintf(stderr, "error writing checkpoint %s\n",
+                        opt.checkpointName);
+                writer.finish();
+                fclose(output);
+                return false;
+            }
+        }
+
+        // average the samples: wavefront colors were summed over them
+        for(size_t k=0; k != colors.size(); ++k)
+            colors[k] = opt.wavefront ? colors[k] / float(opt.samples)
+                                      : sums[k].sum / float(sums[k].n);
+        writer.add(colors);
+    }
+    bool written = writer.finish();
+    if (fclose(output) != 0) written = false;
+    seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    rays = opt.wavefront ? long(cam.width)*cam.height*opt.samples
+                         : long(traced);
+    if (! written) {
+        fprintf(stderr, "error writing %s\n", opt.outName);
+        return false;
+    }
+
+    if (opt.heatName) {
+        FILE *heatFile = fopen(opt.heatName, "wb");
+        bool ok = heatFile &&
+            (ImageWriter::formatOf(opt.heatName) == ImageWriter::PFM
+             ? heatmap.writePFM(heatFile) : heatmap.writePPM(heatFile));
+        if (heatFile && fclose(heatFile) != 0) ok = false;
+        if (! ok) {
+            fprintf(stderr, "error writing %s\n", opt.heatName);
+            return false;
+        }
+        if (opt.verbose)
+            printf("heatmap: %s per pixel, mean %.1f, largest %.1f\n",
+                   opt.heatMeasure == HEAT_TESTS ? "intersection tests"
+                                                 : "microseconds",
+                   heatmap.mean(), heatmap.maximum());
+    }
+    return true;
+}
+
+// shading effects, which are compiled into the shading variant in use
+static const unsigned SHADING_EFFECTS = World::DIFFUSE | World::SPECULAR |
+    World::SHADOW | World::REFLECT | World::REFRACT;
+
+// A scene loaded once, rendered by jobs from line commands until told
+// to quit. Each job renders on threads of its own, with its own view and
+// options, so several can render at once over the same scene. Loading
+// the scene again replaces it for jobs started after; those already
+// running keep the one they started with until they finish.
+// Shading options are globals every render thread reads, so jobs running
+// at once must agree on them. A job wanting others waits for the running
+// ones to finish, and jobs that would run with the current ones wait
+// behind it rather than keep it waiting
+class RenderServer {
+private: // private data
+    std::string d_sceneName;        // scene file loaded
+    int d_threads;                  // threads to parse NFF on
+    RenderOptions d_defaults;       // options every render starts from
+
+    std::mutex d_lock;              // for the rest
+    std::condition_variable d_changed;
+    std::shared_ptr<const World> d_world; // scene for new jobs
+    int d_jobs;                     // jobs started, for numbering
+    int d_running;                  // jobs not yet finished
+    int d_shading;                  // jobs and loads using the shading globals
+    int d_waiting;                  // jobs waiting to change them
+    std::set<std::string> d_files;  // files running jobs write
+    std::map<int, std::thread> d_jobThreads; // by job, until joined
+    std::vector<int> d_finished;    // jobs whose threads are ending
+
+public: // constructor
+    // serve world, loaded from sceneName, rendering as defaults give
+    // unless a command changes them
+    RenderServer(World *world, const char *sceneName, int threads,
+                 const RenderOptions &defaults)
+        : d_sceneName(sceneName), d_threads(threads), d_defaults(defaults),
+          d_world(world), d_jobs(0), d_running(0), d_shading(0),
+          d_waiting(0) {}
+
+    // wait for every job, so none outlives the server
+    ~RenderServer() { wait(); }
+
+public: // computational members
+    // handle one command line from client, returning false to quit
+    bool command(const CommandServer::ClientPtr &client, char *line);
+
+    // wait for every job to finish
+    void wait();
+
+private: // helpers
+    void start(const CommandServer::ClientPtr &client,
+               std::vector<char*> &words);
+    void reload(const CommandServer::ClientPtr &client, const char *name);
+
+    // join the threads of finished jobs
+    void reap();
+
+    // run while shading as opt asks, or any way if opt is 0
+    void enterShading(const RenderOptions *opt);
+    void leaveShading();
+};
+
+// split line in place into words separated by spaces and tabs. Unlike
+// strtok this keeps no state, since clients' commands are split at once
+static void splitWords(char *line, std::vector<char*> &words)
+{
+    for(char *p = line + strspn(line, " \t"); *p; p += strspn(p, " \t")) {
+        words.push_back(p);
+        p += strcspn(p, " \t");
+        if (*p) *p++ = 0;
+    }
+}
+
+bool
+RenderServer::command(const CommandServer::ClientPtr &client, char *line)
+{
+    std::vector<char*> words;
+    splitWords(line, words);
+    if (words.empty())
+        return true;
+
+    if (strcmp(words[0], "render") == 0)
+        start(client, words);
+    else if (strcmp(words[0], "reload") == 0 && words.size() <= 2)
+        reload(client, words.size() == 2 ? words[1] : 0);
+    else if (strcmp(words[0], "wait") == 0 && words.size() == 1) {
+        wait();
+        client->reply("idle");
+    }
+    else if (strcmp(words[0], "quit") == 0 && words.size() == 1)
+        return false;
+    else
+        client->reply("error: unknown command %s", words[0]);
+    return true;
+}
+
+// parse a render command and start its job on a thread of its own
+void
+RenderServer::start(const CommandServer::ClientPtr &client,
+                    std::vector<char*> &words)
+{
+    // the job keeps its own copy of the words its options point into
+    struct Job {
+        int id;
+        std::vector<std::string> words;
+        std::vector<char*> args;
+        std::string outName;        // when not given with -o
+        RenderOptions opt;
+        std::shared_ptr<const World> world;
+    };
+    reap();
+
+    std::shared_ptr<Job> job(new Job);
+    job->words.assign(words.begin()+1, words.end());
+    for(size_t k=0; k != job->words.size(); ++k)
+        job->args.push_back(&job->words[k][0]);
+
+    RenderOptions &opt = job->opt;
+    opt = d_defaults;
+    int argc = int(job->args.size());
+    char **argv = argc ? &job->args[0] : 0;
+    while(argc != 0) {
+        int used = parseRenderOption(argc, argv, opt);
+        if (! used) {
+            client->reply("error: bad render option %s", argv[0]);
+            return;
+        }
+        argv += used; argc -= used;
+    }
+    if (opt.conflicting()) {
+        client->reply("error: -wavefront with -adaptive, -lights, "
+                      "-checkpoint or -heatmap");
+        return;
+    }
+    if ((opt.effects ^ d_defaults.effects) & LOAD_EFFECTS) {
+        client->reply("error: -no polygons, cones and spheres only apply "
+                      "when loading the scene");
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> hold(d_lock);
+        int id = d_jobs + 1;
+        if (opt.outName == d_defaults.outName) {
+            char name[32];
+            snprintf(name, sizeof(name), "job%d.ppm", id);
+            job->outName = name;
+            opt.outName = job->outName.c_str();
+        }
+
+        // jobs running at once can't share a file, nor can one job's
+        const char *files[] = { opt.outName, opt.heatName, opt.checkpointName };
+        for(int k=0; k<3; ++k) {
+            if (files[k] && d_files.count(files[k])) {
+                client->reply("error: %s is in use by a running job",
+                              files[k]);
+                return;
+            }
+            for(int j=0; j<k; ++j)
+                if (files[k] && files[j] && strcmp(files[k], files[j]) == 0) {
+                    client->reply("error: %s named twice", files[k]);
+                    return;
+                }
+        }
+        for(int k=0; k<3; ++k)
+            if (files[k])
+                d_files.insert(files[k]);
+
+        job->id = d_jobs = id;
+        job->world = d_world;
+        ++d_running;
+    }
+    client->reply("job %d started", job->id);
+
+    // held while the thread is kept, so it is kept before it can finish
+    std::lock_guard<std::mutex> hold(d_lock);
+    d_jobThreads[job->id] = std::thread([this, job, client]() {
+        enterShading(&job->opt);
+        long rays = 0;
+        double seconds = 0;
+        bool ok = render(*job->world, job->opt, rays, seconds);
+        leaveShading();
+
+        if (ok)
+            client->reply("job %d done: %s, %ld primary rays in %.2f ms",
+                          job->id, job->opt.outName, rays, seconds * 1000);
+        else
+            client->reply("job %d failed", job->id);
+        Stats::flush();
+
+        // last: the thread is joined once the job is counted finished
+        std::lock_guard<std::mutex> hold(d_lock);
+        d_files.erase(job->opt.outName);
+        if (job->opt.heatName)
+            d_files.erase(job->opt.heatName);
+        if (job->opt.checkpointName)
+            d_files.erase(job->opt.checkpointName);
+        d_finished.push_back(job->id);
+        --d_running;
+        d_changed.notify_all();
+    });
+}
+
+// load the scene again, or the one named name if it isn't 0, for jobs
+// started from now on. If it can't be loaded, the scene stays as it was
+void
+RenderServer::reload(const CommandServer::ClientPtr &client, const char *name)
+{
+    std::string sceneName;
+    {
+        std::lock_guard<std::mutex> hold(d_lock);
+        sceneName = name ? name : d_sceneName;
+    }
+    name = sceneName.c_str();
+
+    FILE *infile = fopen(name, "rb");
+    if (!infile) {
+        client->reply("error opening %s", name);
+        return;
+    }
+
+    // loading reads World::effects, which changing the shading would write
+    enterShading(0);
+    World *world = 0;
+    std::string why;
+    try {
+        world = new World(infile, d_threads);
+    }
+    catch(const SceneError &e) {
+        why = e.what();
+    }
+    leaveShading();
+    fclose(infile);
+    if (! world) {
+        client->reply("error loading %s: %s", name, why.c_str());
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> hold(d_lock);
+        d_world.reset(world);
+        d_sceneName = sceneName;
+    }
+    client->reply("loaded %s: %s over %d objects, built in %.2f ms",
+                  name, world->objects.accelName(), world->objects.size(),
+                  world->objects.buildTime() * 1000);
+}
+
+void
+RenderServer::wait()
+{
+    {
+        std::unique_lock<std::mutex> hold(d_lock);
+        d_changed.wait(hold, [this]() { return d_running == 0; });
+    }
+    reap();
+}
+
+// each finished thread is taken by one caller, and joined outside the
+// lock it takes last
+void
+RenderServer::reap()
+{
+    std::vector<std::thread> done;
+    {
+        std::lock_guard<std::mutex> hold(d_lock);
+        for(size_t k=0; k != d_finished.size(); ++k) {
+            done.push_back(std::move(d_jobThreads[d_finished[k]]));
+            d_jobThreads.erase(d_finished[k]);
+        }
+        d_finished.clear();
+    }
+    for(size_t k=0; k != done.size(); ++k)
+        done[k].join();
+}
+
+// do the shading globals already have opt's values?
+static bool sameShading(const RenderOptions &opt)
+{
+    return ((opt.effects ^ World::effects) & SHADING_EFFECTS) == 0 &&
+        opt.lightSamples == Appearance::lightSamples &&
+        opt.depth == Appearance::depth;
+}
+
+void
+RenderServer::enterShading(const RenderOptions *opt)
+{
+    std::unique_lock<std::mutex> hold(d_lock);
+    bool waiting = false;           // counted in d_waiting
+    for(;;) {
+        bool same = ! opt || sameShading(*opt);
+        if (d_shading == 0 || (same && d_waiting == (waiting ? 1 : 0)))
+            break;
+        if (! same && ! waiting) {
+            ++d_waiting;
+            waiting = true;
+        }
+        d_changed.wait(hold);
+    }
+    if (waiting) {
+        --d_waiting;
+        d_changed.notify_all();
+    }
+
+    if (opt && d_shading == 0) {
+        World::effects = (World::effects & ~SHADING_EFFECTS) |
+                         (opt->effects & SHADING_EFFECTS);
+        Appearance::lightSamples = opt->lightSamples;
+        Appearance::depth = opt->depth;
+        Appearance::specialize(World::effects);
+    }
+    ++d_shading;
+}
+
+void
+RenderServer::leaveShading()
+{
+    std::lock_guard<std::mutex> hold(d_lock);
+    if (--d_shading == 0)
+        d_changed.notify_all();
+}
+
 int main(int argc, char **argv)
 {
     // defaults for command line arguments
-    float aperture = 0;         // depth of field aperture
-    int samples = 1;            // depth of field and antialiasing samples
+    RenderOptions opt;          // everything about the render
     FILE *infile = stdin;       // input file
+    const char *sceneName = 0;  // its name, if not stdin
+    const char *compileTo = 0;  // compiled scene to write instead of rendering
+    const char *statsName = 0;  // JSON statistics file
+    bool serve = false;         // take render commands instead
+    const char *socketName = 0; // from this socket rather than stdin
 
-    // Default some things to off
-    World::effects &= ~World::DEPTH_OF_FIELD;
-    World::effects &= ~World::ANTIALIAS;
-    
     // parse command line arguments
     char *progname = argv[0];
     ++argv; --argc;
     while(argc != 0) {
         // print usage on -h, -help, -?, --h, --help, etc.
-        if (strncmp(argv[0], "-h", 2) == 0 || 
-                strncmp(argv[0], "--h", 3) == 0 || 
+        if ((strncmp(argv[0], "-h", 2) == 0 &&
+             strcmp(argv[0], "-heatmap") != 0) ||
+                strncmp(argv[0], "--h", 3) == 0 ||
                 strcmp(argv[0], "-?") == 0)
             break;
 
-        if (argc >= 2 && strcmp(argv[0], "-s") == 0) {
-            sscanf(argv[1], "%d", &samples);
+        int used = parseRenderOption(argc, argv, opt);
+        if (used) {
+            argv += used; argc -= used;
+            continue;
+        }
+
+        if (argc >= 2 && strcmp(argv[0], "-accel") == 0) {
+            if (strcmp(argv[1], "list") == 0)
+                ObjectList::accel = ObjectList::ACCEL_LIST;
+            else if (strcmp(argv[1], "flat") == 0)
+                ObjectList::accel = ObjectList::ACCEL_FLAT;
+            else if (strcmp(argv[1], "bvh") == 0)
+                ObjectList::accel = ObjectList::ACCEL_BVH;
+            else if (strcmp(argv[1], "grid") == 0)
+                ObjectList::accel = ObjectList::ACCEL_GRID;
+            else if (strcmp(argv[1], "auto") == 0)
+                ObjectList::accel = ObjectList::ACCEL_AUTO;
+            else
+                break;                  // leave unparsed, prints usage
+            argv += 2; argc -= 2;
+            continue;
+        }
+
+        if (argc >= 2 && strcmp(argv[0], "-simd") == 0) {
+            if (strcmp(argv[1], "scalar") == 0)
+                Simd::select(Simd::SCALAR);
+            else if (strcmp(argv[1], "sse") == 0)
+                Simd::select(Simd::SSE);
+            else if (strcmp(argv[1], "avx2") == 0)
+                Simd::select(Simd::AVX2);
+            else
+                break;                  // leave unparsed, prints usage
             argv += 2; argc -= 2;
             continue;
         }
 
-        if (argc >= 2 && strcmp(argv[0], "-dof") == 0) {
-            sscanf(argv[1], "%f", &aperture);
-            World::effects |= World::DEPTH_OF_FIELD;
+        if (argc >= 2 && strcmp(argv[0], "--stats") == 0) {
+            statsName = argv[1];
             argv += 2; argc -= 2;
             continue;
         }
 
-        if (strcmp(argv[0], "-aa") == 0) {
-            World::effects |= World::ANTIALIAS;
+        if (argc >= 3 && strcmp(argv[0], "--compile") == 0) {
+            infile = fopen(argv[1], "rb");
+            if (!infile) {
+                fprintf(stderr, "error opening %s\n", argv[1]);
+                return 1;
+            }
+            compileTo = argv[2];
+            argv += 3; argc -= 3;
+            continue;
+        }
+
+        if (strcmp(argv[0], "--serve") == 0) {
+            serve = true;
             argv += 1; argc -= 1;
             continue;
         }
 
-        if (argc >= 2 && strcmp(argv[0], "-no") == 0) {
-            if (strcmp(argv[1], "diffuse") == 0) 
-                World::effects &= ~World::DIFFUSE;
-            else if (strcmp(argv[1], "specular") == 0)
-                World::effects &= ~World::SPECULAR;
-            else if (strcmp(argv[1], "shadow") == 0)
-                World::effects &= ~World::SHADOW;
-            else if (strcmp(argv[1], "reflect") == 0)
-                World::effects &= ~World::REFLECT;
-            else if (strcmp(argv[1], "refract") == 0)
-                World::effects &= ~World::REFRACT;
-            else if (strcmp(argv[1], "polygons") == 0)
-                World::effects &= ~World::POLYGONS;
-            else if (strcmp(argv[1], "cones") == 0)
-                World::effects &= ~World::CONES;
-            else if (strcmp(argv[1], "spheres") == 0)
-                World::effects &= ~World::SPHERES;
-            else
-                break;                  // leave unparsed, prints usage
+        if (argc >= 2 && strcmp(argv[0], "--socket") == 0) {
+            serve = true;
+            socketName = argv[1];
             argv += 2; argc -= 2;
             continue;
         }
 
         if (argc == 1) {
-            infile = fopen(argv[0], "r");
+            infile = fopen(argv[0], "rb");
             if (!infile) {
-                fprintf(stderr, "error opening %s\n", argv[1]);
+                fprintf(stderr, "error opening %s\n", argv[0]);
                 return 1;
             }
+            sceneName = argv[0];
             argv += 1; argc -= 1;
             continue;
         }
@@ -132,9 +1039,11 @@ int main(int argc, char **argv)
         break;
     }
 
-    // unparsed arguments? print usage and exit
-    if (argc > 0) {
-        printf("Usage: %s [options] [file.nff]\n", progname);
+    // unparsed arguments or options that don't mix? print usage and exit
+    if (argc > 0 || opt.conflicting() ||
+        (serve && (compileTo || ! sceneName))) {
+        printf("Usage: %s [options] [file.nff | file.tsc]\n", progname);
+        printf("       %s --serve [options] file.nff | file.tsc\n", progname);
         printf("options:\n"
                 "  -dof <aperture>\n"
                 "    define a lens aperture for depth of field\n"
@@ -142,80 +1051,170 @@ int main(int argc, char **argv)
                 "    enable antialiasing\n"
                 "  -s <samples>\n"
                 "    number of depth of field and antialiasing samples\n"
+                "  -adaptive <error>\n"
+                "    sample each pixel until the standard error of its brightness\n"
+                "    is below error (0 to 1), up to -s samples. Not with -wavefront\n"
+                "  -lights <n>\n"
+                "    in scenes with more than n lights, shade each hit with n shadow\n"
+                "    rays toward lights picked by their likely contribution.\n"
+                "    Not with -wavefront\n"
+                "  -depth <n>\n"
+                "    reflections and refractions traced after each primary ray\n"
+                "    (0 to 64, default 5)\n"
+                "  -sampler halton, -sampler sobol\n"
+                "    depth of field and antialiasing sample pattern: one Halton\n"
+                "    pattern over the image (default), or Owen-scrambled Sobol\n"
+                "    points for each pixel\n"
+                "  -eye <x y z>, -at <x y z>, -up <x y z>, -angle <degrees>\n"
+                "    change the view from the scene's, as in an NFF 'v' record\n"
+                "  -size <width> <height>\n"
+                "    change the image size from the scene's, keeping the\n"
+                "    vertical field of view\n"
+                "  -accel list, -accel flat, -accel bvh, -accel grid, -accel auto\n"
+                "    acceleration structure (default auto: chosen from scene)\n"
+                "  -packet <n>\n"
+                "    trace primary rays in n x n pixel packets (1 to 4, default 4)\n"
+                "  -o <file>\n"
+                "    image file (default trace.ppm), floating point PFM if it\n"
+                "    ends in .pfm\n"
+                "  -strip <lines>\n"
+                "    render this many lines at a time (default 256), writing each\n"
+                "    strip to the image file while the next one renders\n"
+                "  -checkpoint <file>\n"
+                "    save each pixel's sample totals to file after every strip, and\n"
+                "    continue from the totals already there: after an interrupted\n"
+                "    run with the same options, or to add samples with a larger -s.\n"
+                "    Not with -wavefront\n"
+                "  -heatmap tests <file>, -heatmap time <file>\n"
+                "    also write an image of the intersection tests or microseconds\n"
+                "    spent on each pixel over all its samples and bounces, with a\n"
+                "    legend below it; PFM files hold the numbers, with no legend.\n"
+                "    Counting tests needs statistics compiled in. Not with -wavefront\n"
+                "  -threads <n>\n"
+                "    render on n threads (default: one per core)\n"
+                "  -wavefront\n"
+                "    trace breadth first from sorted ray queues\n"
+                "  -simd scalar, -simd sse, -simd avx2\n"
+                "    sphere, cone and triangle kernels, used by -accel flat, bvh\n"
+                "    and grid (default: best the CPU supports)\n"
                 "  -no diffuse, -no specular, -no shadow\n"
                 "  -no reflect, -no refract\n"
                 "  -no polygons, -no cones, -no spheres\n"
-                "    turn off ray-tracing features\n");
+                "    turn off ray-tracing features\n"
+                "  -with <feature>\n"
+                "    turn one back on, such as in a render command\n"
+                "  --compile file.nff file.tsc\n"
+                "    save the loaded scene and its acceleration structure as a\n"
+                "    compiled scene, which loads without parsing. -no polygons,\n"
+                "    cones and spheres take effect when compiling\n"
+                "  --stats <file>\n"
+                "    write ray, intersection test and timing statistics to file\n"
+                "    as JSON\n"
+                "  --serve\n"
+                "    load the scene once, then read commands from stdin, one a\n"
+                "    line, replying on stdout. Other options are the defaults\n"
+                "    for every render:\n"
+                "      render [options]  start rendering with these options too,\n"
+                "                        alongside any renders already going.\n"
+                "                        Without -o, job N writes jobN.ppm\n"
+                "      reload [file]     load the scene, or another, for renders\n"
+                "                        started after\n"
+                "      wait              reply once every render is done\n"
+                "      quit              stop once every render is done\n"
+                "  --socket <path>\n"
+                "    serve commands from clients of a UNIX socket made at path\n"
+                "    instead of stdin\n");
         return 1;
     }
 
-    // everything we know about the world
-    // image parameters, camera parameters
-    World world(infile);
-
-    // array of image data in ppm-file order
-    unsigned char (*pixels)[3] = new unsigned char[world.height*world.width][3];
-
-    // spawn a ray for each pixel and place the result in the pixel
-    for(int j=0; j<world.height; ++j) {
-
-        if (j % 32 == 0) printf("line %d\n",j); // show current line
-        for(int i=0; i<world.width; ++i) {
-
-            // depth of field and antialiasing samples
-            Vec3 col;
-            for(int samp = 0; samp < samples; ++samp) {
-                // Hammersley coordinate within pixel:
-                //   (x bits | sample bits | reversed y bits)
-                int ii = world.height*(i*samples + samp);
-                ii += int(halton(j,2) * world.height);
-
-                // new jittered eye position
-                float dofX = 0, dofY = 0;
-                if (World::effects & World::DEPTH_OF_FIELD) {
-                    dofX = halton(ii, 3) - 0.5f, dofY = halton(ii, 5) - 0.5f;
-                    disk(dofX, dofY);
-                    dofX *= aperture; dofY *= aperture;
-                }
-                Vec3 eye = world.eye + dofX * world.u + dofY * world.v;
+    // settings every render thread reads
+    World::effects = opt.effects;
+    Appearance::lightSamples = opt.lightSamples;
+    Appearance::depth = opt.depth;
 
-                // new ray center
-                float aaX = 0, aaY = 0;
-                if (World::effects & World::ANTIALIAS) {
-                    aaX = halton(ii, 7) - 0.5f, aaY = halton(ii,11) - 0.5f;
-                    gaussian(aaX, aaX);
-                }
-                float us = world.left + 
-                    (world.right - world.left) * (i+aaX+0.5f)/world.width;
-                float vs = world.top + 
-                    (world.bottom - world.top) * (j+aaY+0.5f)/world.height;
-                Vec3 pix = world.eye - world.dist * world.w 
-                    + us * world.u + vs * world.v;
-
-                // new ray allowing up to 5 bounces, ray contribution=255,
-                // index of refraction=1, don't trace closer than hither plane
-                Ray ray(eye, pix - eye, 
-                        world.hither / world.dist, INFINITY,
-                        5, 255);
-                col = col + world.objects.trace(ray).color(world, ray);
-            }
-            col = col / float(samples);
+    // shading compiled for just the effects asked for
+    Appearance::specialize(World::effects);
 
-            // assign color
-            pixels[j*world.width + i][0] = col.r();
-            pixels[j*world.width + i][1] = col.g();
-            pixels[j*world.width + i][2] = col.b();
+    // everything we know about the world
+    // image parameters, camera parameters
+    World *world;
+    try {
+        world = new World(infile, opt.threads);
+    }
+    catch(const SceneError &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    if (compileTo) {
+        FILE *output = fopen(compileTo, "wb");
+        bool ok = output && SceneFile::write(*world, output);
+        if (output && fclose(output) != 0) ok = false;
+        if (! ok) {
+            fprintf(stderr, "error writing %s\n", compileTo);
+            return 1;
         }
+        printf("compiled %d objects in %d groups to %s\n",
+               world->objects.size(), int(world->groups.size()), compileTo);
+        delete world;
+        return 0;
+    }
+    printf("%s over %d objects, built in %.2f ms\n",
+           world->objects.accelName(), world->objects.size(),
+           world->objects.buildTime() * 1000);
+    bool kernels = world->objects.accelerated();
+    for(GroupMap::const_iterator gi=world->groups.begin();
+        gi != world->groups.end(); ++gi)
+        kernels = kernels || gi->second->accelerated();
+    printf("simd kernels: %s\n",
+           kernels ? Simd::name(Simd::level()) : "none");
+
+    if (serve) {
+        fclose(infile);
+        opt.verbose = false;
+        RenderServer server(world, sceneName, opt.threads, opt);
+        CommandServer::Handler handler =
+            [&server](const CommandServer::ClientPtr &client, char *line) {
+                return server.command(client, line);
+            };
+        fflush(stdout);
+        bool served = true;
+        if (socketName)
+            served = CommandServer::serveSocket(socketName, handler);
+        else
+            CommandServer::serveStdin(handler);
+        server.wait();
+        if (! served)
+            return 1;
     }
-    printf("done\n");
+    else {
+        long rays = 0;
+        double renderTime = 0;
+        bool rendered = render(*world, opt, rays, renderTime);
+        Camera cam = opt.camera(*world);
+        delete world;
+        if (! rendered)
+            return 1;
 
-    // write ppm file of pixels
-    FILE *output = fopen("trace.ppm","wb");
-    fprintf(output, "P6\n%d %d\n255\n", world.width, world.height);
-    fwrite(pixels, world.height*world.width*3, 1, output);
-    fclose(output);
+        printf("done\n");
+        printf("rendered %ld primary rays in %.2f ms\n", rays, renderTime * 1000);
+        if (opt.adaptive > 0)
+            printf("adaptive: %.2f of up to %d samples per pixel\n",
+                   double(rays) / (cam.width*cam.height), opt.samples);
+        if (ShadowCache::probes())
+            printf("shadow cache: %ld of %ld shadow rays hit (%.1f%%)\n",
+                   ShadowCache::hits(), ShadowCache::probes(),
+                   100. * ShadowCache::hits() / ShadowCache::probes());
+        Stats::print(stdout);
+    }
 
-    delete[] pixels;
+    if (statsName) {
+        FILE *statsFile = fopen(statsName, "w");
+        bool ok = statsFile && Stats::writeJson(statsFile);
+        if (statsFile && fclose(statsFile) != 0) ok = false;
+        if (! ok) {
+            fprintf(stderr, "error writing %s\n", statsName);
+            return 1;
+        }
+    }
     return 0;
 }
-